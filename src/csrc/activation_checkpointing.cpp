@@ -0,0 +1,227 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2023 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <vector>
+
+#include <ATen/CPUGeneratorImpl.h>
+#include <ATen/cuda/CUDAGeneratorImpl.h>
+#include <torch/torch.h>
+
+#include "internal/activation_checkpointing.h"
+
+namespace torchfort {
+
+namespace {
+
+using torch::autograd::AutogradContext;
+using torch::autograd::variable_list;
+
+// Holder to pass the segment function through the autograd context.
+struct SegmentHolder : torch::CustomClassHolder {
+  SegmentHolder(const SegmentFunction& fn) : fn(fn) {}
+  SegmentFunction fn;
+};
+
+// Snapshot of the default generators, used to replay dropout masks during recomputation.
+struct RNGState {
+  torch::Tensor cpu_state;
+  torch::Tensor cuda_state;
+  int cuda_device = -1;
+
+  static RNGState get(const torch::Device& device) {
+    RNGState state;
+    {
+      auto gen = at::detail::getDefaultCPUGenerator();
+      std::lock_guard<std::mutex> lock(gen.mutex());
+      state.cpu_state = gen.get_state();
+    }
+    if (device.is_cuda()) {
+      state.cuda_device = device.has_index() ? device.index() : 0;
+      auto gen = at::cuda::detail::getDefaultCUDAGenerator(state.cuda_device);
+      std::lock_guard<std::mutex> lock(gen.mutex());
+      state.cuda_state = gen.get_state();
+    }
+    return state;
+  }
+
+  void set() const {
+    {
+      auto gen = at::detail::getDefaultCPUGenerator();
+      std::lock_guard<std::mutex> lock(gen.mutex());
+      gen.set_state(cpu_state);
+    }
+    if (cuda_device >= 0) {
+      auto gen = at::cuda::detail::getDefaultCUDAGenerator(cuda_device);
+      std::lock_guard<std::mutex> lock(gen.mutex());
+      gen.set_state(cuda_state);
+    }
+  }
+};
+
+struct CheckpointFunction : public torch::autograd::Function<CheckpointFunction> {
+  // args holds the segment inputs followed by the segment parameters
+  static variable_list forward(AutogradContext* ctx, const SegmentFunction& fn, int64_t num_inputs,
+                               const variable_list& args) {
+    std::vector<torch::Tensor> inputs(args.begin(), args.begin() + num_inputs);
+    auto rng_state = RNGState::get(inputs[0].device());
+
+    ctx->saved_data["fn"] = c10::IValue::make_capsule(c10::make_intrusive<SegmentHolder>(fn));
+    ctx->saved_data["num_inputs"] = num_inputs;
+    ctx->saved_data["cpu_rng_state"] = rng_state.cpu_state;
+    ctx->saved_data["cuda_device"] = static_cast<int64_t>(rng_state.cuda_device);
+    if (rng_state.cuda_device >= 0) {
+      ctx->saved_data["cuda_rng_state"] = rng_state.cuda_state;
+    }
+    ctx->save_for_backward(args);
+
+    // grad mode is disabled here, so no intermediate activations are kept
+    return fn(inputs);
+  }
+
+  static variable_list backward(AutogradContext* ctx, variable_list grad_outputs) {
+    auto args = ctx->get_saved_variables();
+    auto num_inputs = ctx->saved_data["num_inputs"].toInt();
+    auto holder = ctx->saved_data["fn"].toCapsule();
+    const auto& fn = static_cast<SegmentHolder*>(holder.get())->fn;
+
+    RNGState rng_state;
+    rng_state.cpu_state = ctx->saved_data["cpu_rng_state"].toTensor();
+    rng_state.cuda_device = ctx->saved_data["cuda_device"].toInt();
+    if (rng_state.cuda_device >= 0) {
+      rng_state.cuda_state = ctx->saved_data["cuda_rng_state"].toTensor();
+    }
+
+    // detach inputs so that the recomputed graph ends here
+    std::vector<torch::Tensor> inputs(num_inputs);
+    for (int64_t i = 0; i < num_inputs; ++i) {
+      inputs[i] = args[i].detach().requires_grad_(args[i].requires_grad());
+    }
+
+    // recompute the segment with the generator state of the forward pass
+    std::vector<torch::Tensor> outputs;
+    {
+      torch::Device device = inputs[0].device();
+      auto current_rng_state = RNGState::get(device);
+      rng_state.set();
+      torch::AutoGradMode enable_grad(true);
+      outputs = fn(inputs);
+      current_rng_state.set();
+    }
+
+    std::vector<torch::Tensor> diff_outputs, diff_grad_outputs;
+    for (size_t i = 0; i < outputs.size(); ++i) {
+      if (outputs[i].requires_grad() && grad_outputs[i].defined()) {
+        diff_outputs.push_back(outputs[i]);
+        diff_grad_outputs.push_back(grad_outputs[i]);
+      }
+    }
+
+    std::vector<torch::Tensor> diff_args;
+    std::vector<size_t> diff_idx;
+    for (size_t i = 0; i < args.size(); ++i) {
+      auto& arg = (i < num_inputs) ? inputs[i] : args[i];
+      if (arg.requires_grad()) {
+        diff_args.push_back(arg);
+        diff_idx.push_back(i);
+      }
+    }
+
+    // no gradient for fn and num_inputs
+    variable_list grads(args.size() + 2);
+    if (diff_outputs.empty() || diff_args.empty()) {
+      return grads;
+    }
+
+    auto diff_grads = torch::autograd::grad(diff_outputs, diff_args, diff_grad_outputs, /*retain_graph=*/false,
+                                            /*create_graph=*/false, /*allow_unused=*/true);
+    for (size_t i = 0; i < diff_idx.size(); ++i) {
+      grads[diff_idx[i] + 2] = diff_grads[i];
+    }
+    return grads;
+  }
+};
+
+} // namespace
+
+std::vector<torch::Tensor> checkpoint(const SegmentFunction& fn, const std::vector<torch::Tensor>& inputs,
+                                      const std::vector<torch::Tensor>& params) {
+  // nothing to save if no graph is recorded
+  if (!torch::GradMode::is_enabled()) {
+    return fn(inputs);
+  }
+
+  variable_list args(inputs.begin(), inputs.end());
+  args.insert(args.end(), params.begin(), params.end());
+  return CheckpointFunction::apply(fn, static_cast<int64_t>(inputs.size()), args);
+}
+
+std::vector<torch::Tensor> checkpoint_sequential(const std::vector<SegmentFunction>& layers,
+                                                 const std::vector<std::vector<torch::Tensor>>& layer_params,
+                                                 int num_segments, const std::vector<torch::Tensor>& inputs) {
+  int num_layers = layers.size();
+  num_segments = std::clamp(num_segments, 1, std::max(num_layers, 1));
+  int segment_size = (num_layers + num_segments - 1) / num_segments;
+
+  auto x = inputs;
+  for (int start = 0; start < num_layers; start += segment_size) {
+    int end = std::min(start + segment_size, num_layers);
+
+    // copy the layer functions since the segment is replayed after this function returns
+    std::vector<SegmentFunction> segment(layers.begin() + start, layers.begin() + end);
+    auto run_segment = [segment](const std::vector<torch::Tensor>& inputs) {
+      auto y = inputs;
+      for (const auto& layer : segment) {
+        y = layer(y);
+      }
+      return y;
+    };
+
+    // the last segment is needed for backward right away, do not recompute it
+    if (end == num_layers) {
+      x = run_segment(x);
+    } else {
+      std::vector<torch::Tensor> params;
+      for (int i = start; i < end; ++i) {
+        params.insert(params.end(), layer_params[i].begin(), layer_params[i].end());
+      }
+      x = checkpoint(run_segment, x, params);
+    }
+  }
+  return x;
+}
+
+int default_checkpoint_segments(int num_layers) {
+  return std::max(1, static_cast<int>(std::lround(std::sqrt(static_cast<double>(num_layers)))));
+}
+
+} // namespace torchfort
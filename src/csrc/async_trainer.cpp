@@ -0,0 +1,214 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2023 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <set>
+#include <string>
+#include <utility>
+
+#include <ATen/cuda/CUDAEvent.h>
+#include <c10/cuda/CUDAGuard.h>
+#include <c10/cuda/CUDAStream.h>
+#include <torch/torch.h>
+#include <yaml-cpp/yaml.h>
+
+#include "internal/async_trainer.h"
+#include "internal/exceptions.h"
+#include "internal/param_map.h"
+#include "internal/setup.h"
+#include "internal/utils.h"
+
+namespace torchfort {
+
+AsyncTrainer::AsyncTrainer(StepFunction step_fn, size_t queue_size, AsyncTrainingPolicy policy, torch::Device device)
+    : step_fn_(std::move(step_fn)), queue_size_(queue_size), policy_(policy), device_(device), rng_() {
+  thread_ = std::thread(&AsyncTrainer::run, this);
+}
+
+AsyncTrainer::~AsyncTrainer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  queue_cv_.notify_all();
+  space_cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void AsyncTrainer::rethrowError() {
+  if (error_) {
+    auto error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void AsyncTrainer::push(torch::Tensor input, torch::Tensor label) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rethrowError();
+  }
+
+  // stage copies on the submitting stream, the training thread waits for them to complete
+  StagedSample sample;
+  sample.input = input.to(device_, /*non_blocking=*/false, /*copy=*/true);
+  sample.label = label.to(device_, /*non_blocking=*/false, /*copy=*/true);
+  if (device_.is_cuda()) {
+    sample.ready = std::make_shared<at::cuda::CUDAEvent>();
+    sample.ready->record(c10::cuda::getCurrentCUDAStream(device_.index()));
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (queue_.size() >= queue_size_) {
+      switch (policy_) {
+      case Block:
+        space_cv_.wait(lock, [&] { return queue_.size() < queue_size_ || stop_ || error_; });
+        rethrowError();
+        break;
+      case DropOldest:
+        queue_.pop_front();
+        n_dropped_++;
+        break;
+      case Subsample: {
+        // replace a random staged sample, so the queue holds a uniform subsample of the submitted data
+        std::uniform_int_distribution<size_t> dist(0, queue_.size() - 1);
+        queue_[dist(rng_)] = std::move(sample);
+        n_dropped_++;
+        return;
+      }
+      }
+    }
+    queue_.push_back(std::move(sample));
+  }
+  queue_cv_.notify_one();
+}
+
+void AsyncTrainer::wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_cv_.wait(lock, [&] { return (queue_.empty() && !busy_) || error_; });
+  rethrowError();
+}
+
+double AsyncTrainer::loss() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return loss_;
+}
+
+int64_t AsyncTrainer::numDropped() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return n_dropped_;
+}
+
+void AsyncTrainer::run() {
+  // training runs on a dedicated stream of the model device
+  c10::cuda::OptionalCUDAGuard device_guard;
+  c10::cuda::OptionalCUDAStreamGuard stream_guard;
+  if (device_.is_cuda()) {
+    device_guard.set_device(device_);
+    stream_guard.reset_stream(c10::cuda::getStreamFromPool(/*isHighPriority=*/false, device_.index()));
+  }
+
+  while (true) {
+    StagedSample sample;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      queue_cv_.wait(lock, [&] { return !queue_.empty() || stop_; });
+      if (stop_) {
+        return;
+      }
+      sample = std::move(queue_.front());
+      queue_.pop_front();
+      busy_ = true;
+    }
+    space_cv_.notify_one();
+
+    double loss_val = 0.0;
+    std::exception_ptr error;
+    try {
+      std::lock_guard<std::mutex> step_lock(step_mutex_);
+      if (sample.ready) {
+        auto stream = c10::cuda::getCurrentCUDAStream(device_.index());
+        sample.ready->block(stream);
+        loss_val = step_fn_(sample.input, sample.label);
+        // parameters are updated in place: complete the iteration before releasing the model
+        stream.synchronize();
+      } else {
+        loss_val = step_fn_(sample.input, sample.label);
+      }
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      busy_ = false;
+      if (error) {
+        // discard staged samples, the error is reported on the next call from the submitting thread
+        error_ = error;
+        queue_.clear();
+      } else {
+        loss_ = loss_val;
+      }
+    }
+    idle_cv_.notify_all();
+    space_cv_.notify_all();
+  }
+}
+
+std::shared_ptr<AsyncTrainer> get_async_trainer(const YAML::Node& async_training_node,
+                                                AsyncTrainer::StepFunction step_fn, torch::Device device) {
+  auto params = get_params(async_training_node);
+  std::set<std::string> supported_params{"queue_size", "policy"};
+  check_params(supported_params, params.keys());
+
+  int queue_size = params.get_param<int>("queue_size", 2)[0];
+  if (queue_size <= 0) {
+    THROW_INVALID_USAGE("async_training queue_size must be positive.");
+  }
+
+  AsyncTrainingPolicy policy;
+  auto policy_name = sanitize(params.get_param<std::string>("policy", "block")[0]);
+  if (policy_name == "block") {
+    policy = Block;
+  } else if (policy_name == "drop_oldest") {
+    policy = DropOldest;
+  } else if (policy_name == "subsample") {
+    policy = Subsample;
+  } else {
+    THROW_INVALID_USAGE("Unknown async_training policy " + policy_name +
+                        ". Supported policies are: block, drop_oldest, subsample.");
+  }
+
+  return std::make_shared<AsyncTrainer>(std::move(step_fn), queue_size, policy, device);
+}
+
+} // namespace torchfort
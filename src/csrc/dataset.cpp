@@ -0,0 +1,440 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2023 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <mpi.h>
+#include <torch/torch.h>
+#include <yaml-cpp/yaml.h>
+
+#include "internal/dataset.h"
+#include "internal/defines.h"
+#include "internal/exceptions.h"
+#include "internal/model_pack.h"
+#include "internal/nvtx.h"
+#include "internal/param_map.h"
+#include "internal/setup.h"
+#include "internal/training.h"
+#include "internal/utils.h"
+
+namespace torchfort {
+
+static torch::Dtype get_dataset_dtype(const std::string& name) {
+  if (name == "float32" || name == "float") {
+    return torch::kFloat32;
+  } else if (name == "float64" || name == "double") {
+    return torch::kFloat64;
+  }
+  THROW_INVALID_USAGE("Unsupported dataset dtype " + name + ". Supported dtypes are: float32, float64.");
+}
+
+MappedArray::MappedArray(const std::string& fname) {
+  std::ifstream f(fname, std::ios::binary);
+  if (!f) {
+    THROW_INVALID_USAGE("Could not open dataset file " + fname + ".");
+  }
+
+  // .npy header: magic string, format version, little-endian header length and a python dict literal
+  unsigned char preamble[10];
+  f.read(reinterpret_cast<char*>(preamble), sizeof(preamble));
+  if (!f || std::memcmp(preamble, "\x93NUMPY", 6) != 0) {
+    THROW_INVALID_USAGE(fname + " is not a valid .npy file.");
+  }
+  size_t header_len = preamble[8] | (preamble[9] << 8);
+  size_t offset = 10;
+  if (preamble[6] > 1) {
+    unsigned char ext[2];
+    f.read(reinterpret_cast<char*>(ext), sizeof(ext));
+    header_len |= (ext[0] << 16) | (ext[1] << 24);
+    offset = 12;
+  }
+  std::string header(header_len, ' ');
+  f.read(header.data(), header_len);
+  offset += header_len;
+
+  std::smatch match;
+  if (!std::regex_search(header, match, std::regex("'descr':\\s*'([^']*)'"))) {
+    THROW_INVALID_USAGE("Could not read datatype from header of " + fname + ".");
+  }
+  auto descr = match[1].str();
+  if (descr == "<f4") {
+    dtype_ = torch::kFloat32;
+  } else if (descr == "<f8") {
+    dtype_ = torch::kFloat64;
+  } else {
+    THROW_INVALID_USAGE("Unsupported .npy datatype " + descr + " in " + fname + ". Supported datatypes are: <f4, <f8.");
+  }
+
+  if (std::regex_search(header, match, std::regex("'fortran_order':\\s*True"))) {
+    THROW_INVALID_USAGE(fname + " is stored in Fortran order, samples have to be contiguous (C order).");
+  }
+
+  if (!std::regex_search(header, match, std::regex("'shape':\\s*\\(([^)]*)\\)"))) {
+    THROW_INVALID_USAGE("Could not read shape from header of " + fname + ".");
+  }
+  std::vector<int64_t> shape;
+  std::stringstream shape_stream(match[1].str());
+  std::string dim;
+  while (std::getline(shape_stream, dim, ',')) {
+    if (dim.find_first_not_of(" ") != std::string::npos) {
+      shape.push_back(std::stoll(dim));
+    }
+  }
+  if (shape.empty()) {
+    THROW_INVALID_USAGE(fname + " holds a scalar, the leading dimension has to be the sample dimension.");
+  }
+
+  n_samples_ = shape[0];
+  sample_shape_.assign(shape.begin() + 1, shape.end());
+  sample_bytes_ = c10::elementSize(dtype_);
+  for (auto d : sample_shape_) {
+    sample_bytes_ *= d;
+  }
+
+  map(fname, offset);
+}
+
+MappedArray::MappedArray(const std::string& fname, const std::vector<int64_t>& sample_shape, torch::Dtype dtype)
+    : sample_shape_(sample_shape), dtype_(dtype) {
+  sample_bytes_ = c10::elementSize(dtype_);
+  for (auto d : sample_shape_) {
+    sample_bytes_ *= d;
+  }
+  map(fname, 0);
+}
+
+void MappedArray::map(const std::string& fname, size_t offset) {
+  int fd = open(fname.c_str(), O_RDONLY);
+  if (fd < 0) {
+    THROW_INVALID_USAGE("Could not open dataset file " + fname + ": " + std::strerror(errno));
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    THROW_INTERNAL_ERROR("Could not stat dataset file " + fname + ": " + std::strerror(errno));
+  }
+  map_bytes_ = st.st_size;
+  offset_ = offset;
+
+  // raw binary files: infer the number of samples from the file size
+  if (offset_ == 0) {
+    if (sample_bytes_ == 0 || map_bytes_ % sample_bytes_ != 0) {
+      close(fd);
+      THROW_INVALID_USAGE("Size of dataset file " + fname + " is not a multiple of the sample size.");
+    }
+    n_samples_ = map_bytes_ / sample_bytes_;
+  } else if (offset_ + n_samples_ * sample_bytes_ > map_bytes_) {
+    close(fd);
+    THROW_INVALID_USAGE("Dataset file " + fname + " is truncated.");
+  }
+
+  if (map_bytes_ > 0) {
+    addr_ = mmap(nullptr, map_bytes_, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr_ == MAP_FAILED) {
+      addr_ = nullptr;
+      close(fd);
+      THROW_INTERNAL_ERROR("Could not map dataset file " + fname + ": " + std::strerror(errno));
+    }
+  }
+  close(fd);
+}
+
+MappedArray::~MappedArray() {
+  if (addr_) {
+    munmap(addr_, map_bytes_);
+  }
+}
+
+torch::Tensor MappedArray::slice(int64_t begin, int64_t end) const {
+  std::vector<int64_t> shape{end - begin};
+  shape.insert(shape.end(), sample_shape_.begin(), sample_shape_.end());
+  // the mapping is read-only and outlives all batches of an epoch
+  auto ptr = static_cast<char*>(addr_) + offset_ + begin * sample_bytes_;
+  return torch::from_blob(ptr, shape, torch::TensorOptions().dtype(dtype_).device(torch::kCPU));
+}
+
+void MappedArray::prefetch(int64_t begin, int64_t end) const {
+  static const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+  auto first = reinterpret_cast<uintptr_t>(addr_) + offset_ + begin * sample_bytes_;
+  auto last = reinterpret_cast<uintptr_t>(addr_) + offset_ + end * sample_bytes_;
+  first -= first % page_size;
+  madvise(reinterpret_cast<void*>(first), last - first, MADV_WILLNEED);
+}
+
+DatasetLoader::DatasetLoader(
+    std::vector<std::pair<std::shared_ptr<MappedArray>, std::shared_ptr<MappedArray>>> shards, int64_t batch_size,
+    int64_t shuffle_window, int64_t prefetch, int64_t epochs)
+    : shards_(std::move(shards)), batch_size_(batch_size), shuffle_window_(shuffle_window), prefetch_(prefetch),
+      epochs_(epochs), rng_() {
+  for (const auto& [input, label] : shards_) {
+    if (input->numSamples() != label->numSamples()) {
+      THROW_INVALID_USAGE("Number of input and label samples of a dataset shard must match.");
+    }
+  }
+}
+
+DatasetLoader::~DatasetLoader() { stop(); }
+
+void DatasetLoader::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  space_cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+int64_t DatasetLoader::batchesPerEpoch() const {
+  int64_t n_batches = 0;
+  for (const auto& shard : shards_) {
+    n_batches += shard.first->numSamples() / batch_size_;
+  }
+  return n_batches;
+}
+
+void DatasetLoader::startEpoch(int64_t n_batches) {
+  stop();
+  queue_.clear();
+  stop_ = false;
+  error_ = nullptr;
+  thread_ = std::thread(&DatasetLoader::produce, this, n_batches);
+}
+
+std::tuple<torch::Tensor, torch::Tensor> DatasetLoader::next() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  ready_cv_.wait(lock, [&] { return !queue_.empty() || error_; });
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+  auto batch = std::move(queue_.front());
+  queue_.pop_front();
+  lock.unlock();
+  space_cv_.notify_one();
+  return batch;
+}
+
+void DatasetLoader::produce(int64_t n_batches) {
+  try {
+    torch::NoGradGuard no_grad;
+
+    // visit shards in random order when shuffling
+    std::vector<size_t> shard_order(shards_.size());
+    std::iota(shard_order.begin(), shard_order.end(), 0);
+    if (shuffle_window_ > 0) {
+      std::shuffle(shard_order.begin(), shard_order.end(), rng_);
+    }
+
+    int64_t produced = 0;
+    for (auto s : shard_order) {
+      const auto& [input, label] = shards_[s];
+      int64_t n_full = input->numSamples() / batch_size_ * batch_size_;
+
+      // shuffle windows hold a whole number of batches
+      int64_t window = n_full;
+      if (shuffle_window_ > 0) {
+        window = std::max<int64_t>(shuffle_window_ / batch_size_, 1) * batch_size_;
+      }
+
+      for (int64_t w = 0; w < n_full && produced < n_batches; w += window) {
+        int64_t w_end = std::min(w + window, n_full);
+
+        std::vector<int64_t> perm;
+        if (shuffle_window_ > 0) {
+          input->prefetch(w, w_end);
+          label->prefetch(w, w_end);
+          perm.resize(w_end - w);
+          std::iota(perm.begin(), perm.end(), w);
+          std::shuffle(perm.begin(), perm.end(), rng_);
+        }
+
+        for (int64_t b = w; b < w_end && produced < n_batches; b += batch_size_) {
+          std::tuple<torch::Tensor, torch::Tensor> batch;
+          if (shuffle_window_ > 0) {
+            // gather the shuffled samples straight from the mappings
+            auto indices = torch::from_blob(perm.data() + (b - w), {batch_size_}, torch::kInt64);
+            batch = std::make_tuple(input->slice(0, n_full).index_select(0, indices),
+                                    label->slice(0, n_full).index_select(0, indices));
+          } else {
+            // zero-copy views, pages are read ahead while earlier batches are trained on
+            input->prefetch(b, b + batch_size_);
+            label->prefetch(b, b + batch_size_);
+            batch = std::make_tuple(input->slice(b, b + batch_size_), label->slice(b, b + batch_size_));
+          }
+
+          std::unique_lock<std::mutex> lock(mutex_);
+          space_cv_.wait(lock, [&] { return queue_.size() < prefetch_ || stop_; });
+          if (stop_) {
+            return;
+          }
+          queue_.push_back(std::move(batch));
+          lock.unlock();
+          ready_cv_.notify_one();
+          produced++;
+        }
+      }
+    }
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    error_ = std::current_exception();
+  }
+  ready_cv_.notify_all();
+}
+
+std::shared_ptr<DatasetLoader> get_dataset_loader(const YAML::Node& dataset_node, int rank, int size) {
+  if (!dataset_node["type"]) {
+    THROW_INVALID_USAGE("Missing type field in dataset block in configuration file.");
+  }
+  auto type = sanitize(dataset_node["type"].as<std::string>());
+
+  std::set<std::string> supported_params{"batch_size", "shuffle_window", "prefetch", "epochs"};
+  if (type == "bin") {
+    supported_params.insert({"dtype", "input_shape", "label_shape"});
+  } else if (type != "npy") {
+    THROW_INVALID_USAGE("Unknown dataset type " + type + ". Supported types are: npy, bin.");
+  }
+
+  ParamMap params;
+  if (dataset_node["parameters"]) {
+    params = get_params(dataset_node["parameters"]);
+  }
+  check_params(supported_params, params.keys());
+
+  int64_t batch_size;
+  try {
+    batch_size = params.get_param<int>("batch_size")[0];
+  } catch (std::out_of_range) {
+    THROW_INVALID_USAGE("batch_size parameter is required for datasets.");
+  }
+  int64_t shuffle_window = params.get_param<int>("shuffle_window", 0)[0];
+  int64_t prefetch = params.get_param<int>("prefetch", 2)[0];
+  int64_t epochs = params.get_param<int>("epochs", 1)[0];
+  if (batch_size <= 0 || shuffle_window < 0 || prefetch <= 0 || epochs < 0) {
+    THROW_INVALID_USAGE("Invalid dataset parameters: batch_size and prefetch must be positive, shuffle_window and "
+                        "epochs must not be negative.");
+  }
+
+  torch::Dtype dtype;
+  std::vector<int64_t> input_shape, label_shape;
+  if (type == "bin") {
+    try {
+      auto input_shape_int = params.get_param<int>("input_shape");
+      auto label_shape_int = params.get_param<int>("label_shape");
+      input_shape.assign(input_shape_int.begin(), input_shape_int.end());
+      label_shape.assign(label_shape_int.begin(), label_shape_int.end());
+    } catch (std::out_of_range) {
+      THROW_INVALID_USAGE("input_shape and label_shape parameters are required for datasets of type bin.");
+    }
+    dtype = get_dataset_dtype(sanitize(params.get_param<std::string>("dtype", "float32")[0]));
+  }
+
+  auto shards_node = dataset_node["shards"];
+  if (!shards_node || !shards_node["input"] || !shards_node["label"]) {
+    THROW_INVALID_USAGE("Missing shards block with input and label file lists in dataset block.");
+  }
+  auto input_files = shards_node["input"].as<std::vector<std::string>>();
+  auto label_files = shards_node["label"].as<std::vector<std::string>>();
+  if (input_files.size() != label_files.size()) {
+    THROW_INVALID_USAGE("Number of input and label dataset shards must match.");
+  }
+
+  // round-robin assignment of shards to ranks, only the own shards are mapped
+  std::vector<std::pair<std::shared_ptr<MappedArray>, std::shared_ptr<MappedArray>>> shards;
+  for (size_t i = rank; i < input_files.size(); i += size) {
+    if (type == "npy") {
+      shards.emplace_back(std::make_shared<MappedArray>(input_files[i]), std::make_shared<MappedArray>(label_files[i]));
+    } else {
+      shards.emplace_back(std::make_shared<MappedArray>(input_files[i], input_shape, dtype),
+                          std::make_shared<MappedArray>(label_files[i], label_shape, dtype));
+    }
+  }
+
+  return std::make_shared<DatasetLoader>(std::move(shards), batch_size, shuffle_window, prefetch, epochs);
+}
+
+void train_dataset(const char* name, const char* dataset_config_fname) {
+  torchfort::nvtx::rangePush("torchfort_train_dataset");
+
+  check_training_setup(name);
+  wait_async_training(name);
+
+  YAML::Node config;
+  try {
+    config = YAML::LoadFile(dataset_config_fname);
+  } catch (const std::exception& e) {
+    THROW_INVALID_USAGE("Dataset configuration file failed to load.");
+  }
+  if (!config["dataset"]) {
+    THROW_INVALID_USAGE("Missing dataset block in configuration file.");
+  }
+
+  auto comm = models[name].comm;
+  auto loader = comm ? get_dataset_loader(config["dataset"], comm->rank, comm->size)
+                     : get_dataset_loader(config["dataset"]);
+
+  // all ranks run the same number of iterations, so that gradient allreduces stay matched
+  int64_t n_batches = loader->batchesPerEpoch();
+  if (comm) {
+    CHECK_MPI(MPI_Allreduce(MPI_IN_PLACE, &n_batches, 1, MPI_INT64_T, MPI_MIN, comm->mpi_comm));
+  }
+  if (n_batches == 0) {
+    THROW_INVALID_USAGE("Dataset does not provide a full batch to every rank.");
+  }
+
+  auto device = models[name].model->device();
+  for (int64_t epoch = 0; epoch < loader->epochs(); ++epoch) {
+    loader->startEpoch(n_batches);
+    for (int64_t i = 0; i < n_batches; ++i) {
+      auto [input, label] = loader->next();
+      double loss_val;
+      train_step(name, input.to(device), label.to(device), &loss_val);
+    }
+  }
+
+  torchfort::nvtx::rangePop();
+}
+
+} // namespace torchfort
@@ -32,6 +32,7 @@
 #include <nccl.h>
 
 #include <c10/cuda/CUDAStream.h>
+#include <torch/csrc/utils/tensor_flatten.h>
 #include <torch/torch.h>
 
 #include "internal/defines.h"
@@ -39,6 +40,9 @@
 
 namespace torchfort {
 
+// size limit in bytes of the flat buffers coalescing tensor lists for collectives
+static const size_t allreduce_bucket_size = 64 * 1024 * 1024;
+
 static MPI_Datatype get_mpi_dtype(torch::Tensor tensor) {
   auto dtype = tensor.dtype();
 
@@ -139,6 +143,20 @@ void Comm::allreduce(torch::Tensor& tensor, bool average) const {
 }
 
 void Comm::allreduce(std::vector<torch::Tensor>& tensors, bool average) const {
+  torch::NoGradGuard no_grad;
+
+  // coalesce the tensors into flat buckets of equal dtype, this issues one collective per bucket instead of one per
+  // tensor. Single tensor buckets are reduced in place.
+  auto buckets = torch::utils::take_tensors(tensors, allreduce_bucket_size);
+  std::vector<torch::Tensor> flat_tensors;
+  flat_tensors.reserve(buckets.size());
+  for (const auto& bucket : buckets) {
+    if (bucket.tensors.size() == 1) {
+      flat_tensors.push_back(bucket.tensors[0]);
+    } else {
+      flat_tensors.push_back(torch::utils::flatten_dense_tensors(bucket.tensors));
+    }
+  }
 
   if (tensors[0].device().type() == torch::kCUDA) {
     auto torch_stream = c10::cuda::getCurrentCUDAStream().stream();
@@ -147,7 +165,7 @@ void Comm::allreduce(std::vector<torch::Tensor>& tensors, bool average) const {
     CHECK_NCCL(ncclGroupStart());
   }
 
-  for (auto& t : tensors) {
+  for (auto& t : flat_tensors) {
     allreduce(t, average);
   }
 
@@ -157,6 +175,17 @@ void Comm::allreduce(std::vector<torch::Tensor>& tensors, bool average) const {
     CHECK_CUDA(cudaEventRecord(event, stream));
     CHECK_CUDA(cudaStreamWaitEvent(torch_stream, event));
   }
+
+  // copy the reduced buckets back
+  for (size_t i = 0; i < buckets.size(); ++i) {
+    if (buckets[i].tensors.size() == 1) {
+      continue;
+    }
+    auto outputs = torch::utils::unflatten_dense_tensors(flat_tensors[i], buckets[i].tensors);
+    for (size_t j = 0; j < outputs.size(); ++j) {
+      buckets[i].tensors[j].copy_(outputs[j]);
+    }
+  }
 }
 void Comm::allreduce(double& val, bool average) const {
   CHECK_MPI(MPI_Allreduce(MPI_IN_PLACE, &val, 1, MPI_DOUBLE, MPI_SUM, mpi_comm));
@@ -0,0 +1,58 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2023 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include <torch/torch.h>
+
+namespace torchfort {
+
+// A segment of a forward pass which can be recomputed during the backward pass.
+using SegmentFunction = std::function<std::vector<torch::Tensor>(const std::vector<torch::Tensor>&)>;
+
+// Run fn on inputs without storing intermediate activations. The segment is recomputed
+// during the backward pass to obtain gradients with respect to inputs and params. All parameters
+// used by fn have to be passed in params, otherwise they will not receive gradients.
+std::vector<torch::Tensor> checkpoint(const SegmentFunction& fn, const std::vector<torch::Tensor>& inputs,
+                                      const std::vector<torch::Tensor>& params);
+
+// Split a sequence of layers into num_segments segments and checkpoint all but the last one.
+// layer_params[i] holds the parameters used by layers[i].
+std::vector<torch::Tensor> checkpoint_sequential(const std::vector<SegmentFunction>& layers,
+                                                 const std::vector<std::vector<torch::Tensor>>& layer_params,
+                                                 int num_segments, const std::vector<torch::Tensor>& inputs);
+
+// Default segment count, yields O(sqrt(num_layers)) stored activations.
+int default_checkpoint_segments(int num_layers);
+
+} // namespace torchfort
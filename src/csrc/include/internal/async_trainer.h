@@ -0,0 +1,110 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2023 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include <ATen/cuda/CUDAEvent.h>
+#include <torch/torch.h>
+#include <yaml-cpp/yaml.h>
+
+namespace torchfort {
+
+enum AsyncTrainingPolicy { Block = 0, DropOldest = 1, Subsample = 2 };
+
+// Dedicated training thread consuming a bounded queue of staged training samples. Samples are
+// copied on submission, so the caller can reuse its buffers as soon as push returns.
+class AsyncTrainer {
+public:
+  // runs a single training iteration on input and label tensors residing on the model device and returns the loss
+  using StepFunction = std::function<double(torch::Tensor, torch::Tensor)>;
+
+  AsyncTrainer(StepFunction step_fn, size_t queue_size, AsyncTrainingPolicy policy, torch::Device device);
+  ~AsyncTrainer();
+
+  // disable copy constructor
+  AsyncTrainer(const AsyncTrainer&) = delete;
+
+  // stage a copy of input and label for training, applies the back-pressure policy if the queue is full
+  void push(torch::Tensor input, torch::Tensor label);
+
+  // block until all staged samples have been trained on, rethrows errors raised on the training thread
+  void wait();
+
+  // exclusive access to the model in between training iterations
+  std::unique_lock<std::mutex> lockStep() { return std::unique_lock<std::mutex>(step_mutex_); }
+
+  // loss of the most recently completed training iteration
+  double loss() const;
+  int64_t numDropped() const;
+
+private:
+  struct StagedSample {
+    torch::Tensor input;
+    torch::Tensor label;
+    // marks completion of the staging copy on the submitting stream
+    std::shared_ptr<at::cuda::CUDAEvent> ready;
+  };
+
+  void run();
+  void rethrowError();
+
+  StepFunction step_fn_;
+  size_t queue_size_;
+  AsyncTrainingPolicy policy_;
+  torch::Device device_;
+
+  std::deque<StagedSample> queue_;
+  bool busy_ = false;
+  bool stop_ = false;
+  double loss_ = 0.0;
+  int64_t n_dropped_ = 0;
+  std::exception_ptr error_;
+  std::mt19937_64 rng_;
+
+  mutable std::mutex mutex_;
+  std::mutex step_mutex_;
+  std::condition_variable queue_cv_;
+  std::condition_variable space_cv_;
+  std::condition_variable idle_cv_;
+  std::thread thread_;
+};
+
+std::shared_ptr<AsyncTrainer> get_async_trainer(const YAML::Node& async_training_node,
+                                                AsyncTrainer::StepFunction step_fn, torch::Device device);
+
+} // namespace torchfort
@@ -35,6 +35,7 @@
 #include <torch/torch.h>
 
 #include "internal/base_loss.h"
+#include "internal/exceptions.h"
 #include "internal/param_map.h"
 
 namespace torchfort {
@@ -43,6 +44,14 @@ struct BaseLoss : torch::nn::Module {
   virtual std::vector<torch::Tensor> forward(const std::vector<torch::Tensor>& inputs,
                                              const std::vector<torch::Tensor>& labels) = 0;
   virtual void setup(const ParamMap& params) = 0;
+
+  // Loss with per-sample weights along the leading (batch) dimension. The unweighted loss of every sample
+  // is returned in sample_losses.
+  virtual std::vector<torch::Tensor> forward_weighted(const std::vector<torch::Tensor>& inputs,
+                                                      const std::vector<torch::Tensor>& labels,
+                                                      const torch::Tensor& weights, torch::Tensor& sample_losses) {
+    THROW_NOT_SUPPORTED("Per-sample weighting is not supported by this loss.");
+  }
 };
 
 } // namespace torchfort
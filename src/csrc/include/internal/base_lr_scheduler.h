@@ -43,6 +43,10 @@ class BaseLRScheduler : public torch::optim::LRScheduler {
 public:
   BaseLRScheduler(torch::optim::Optimizer& optimizer) : LRScheduler(optimizer) {}
 
+  // Multiple of the configured batch size to use for the next optimizer step. Only batch growth schedules
+  // return values other than 1.
+  virtual int64_t batch_factor() const { return 1; }
+
   // Define generic save/load functionalities. Specialize in derived schedulers if
   // needed.
   void save(const std::string& fname) {
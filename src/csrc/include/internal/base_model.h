@@ -39,6 +39,16 @@ namespace torchfort {
 struct BaseModel : torch::nn::Module {
   virtual std::vector<torch::Tensor> forward(const std::vector<torch::Tensor>& inputs) = 0;
   virtual void setup(const ParamMap& params) = 0;
+
+  // Stateful models take their previous state as additional inputs (none on the first call)
+  // and return the updated state as additional outputs.
+  virtual bool stateful() const { return false; }
+
+  // Models which evaluate all ensemble members in one batched forward accept an ensemble_size parameter.
+  virtual bool batched_ensemble() const { return false; }
+
+  // Number of ensemble members, stacked along the leading dimension of the outputs.
+  virtual int ensemble_size() const { return 1; }
 };
 
 } // namespace torchfort
@@ -0,0 +1,130 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2023 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <torch/torch.h>
+#include <yaml-cpp/yaml.h>
+
+namespace torchfort {
+
+// Read-only memory-mapped array file with samples stored contiguously along the leading dimension.
+class MappedArray {
+public:
+  // .npy file, shape and datatype are read from the header
+  MappedArray(const std::string& fname);
+  // raw binary file, the number of samples is inferred from the file size
+  MappedArray(const std::string& fname, const std::vector<int64_t>& sample_shape, torch::Dtype dtype);
+  ~MappedArray();
+
+  // disable copy constructor
+  MappedArray(const MappedArray&) = delete;
+
+  int64_t numSamples() const { return n_samples_; }
+
+  // zero-copy view of samples [begin, end)
+  torch::Tensor slice(int64_t begin, int64_t end) const;
+
+  // readahead hint for samples [begin, end)
+  void prefetch(int64_t begin, int64_t end) const;
+
+private:
+  void map(const std::string& fname, size_t offset);
+
+  std::vector<int64_t> sample_shape_;
+  torch::Dtype dtype_;
+  int64_t n_samples_ = 0;
+  size_t sample_bytes_ = 0;
+
+  void* addr_ = nullptr;
+  size_t map_bytes_ = 0;
+  size_t offset_ = 0;
+};
+
+// Streams minibatches from the shards of a dataset assigned to this rank. Batches are assembled
+// by a prefetch thread into a bounded queue, optionally shuffled within a window of samples.
+class DatasetLoader {
+public:
+  DatasetLoader(std::vector<std::pair<std::shared_ptr<MappedArray>, std::shared_ptr<MappedArray>>> shards,
+                int64_t batch_size, int64_t shuffle_window, int64_t prefetch, int64_t epochs);
+  ~DatasetLoader();
+
+  // disable copy constructor
+  DatasetLoader(const DatasetLoader&) = delete;
+
+  int64_t epochs() const { return epochs_; }
+
+  // number of full batches available to this rank per epoch
+  int64_t batchesPerEpoch() const;
+
+  // start prefetching the first n_batches batches of a new epoch
+  void startEpoch(int64_t n_batches);
+
+  // next batch of the current epoch, blocks until it is available
+  std::tuple<torch::Tensor, torch::Tensor> next();
+
+private:
+  void produce(int64_t n_batches);
+  void stop();
+
+  std::vector<std::pair<std::shared_ptr<MappedArray>, std::shared_ptr<MappedArray>>> shards_;
+  int64_t batch_size_;
+  int64_t shuffle_window_;
+  size_t prefetch_;
+  int64_t epochs_;
+  std::mt19937_64 rng_;
+
+  std::deque<std::tuple<torch::Tensor, torch::Tensor>> queue_;
+  bool stop_ = false;
+  std::exception_ptr error_;
+  std::mutex mutex_;
+  std::condition_variable ready_cv_;
+  std::condition_variable space_cv_;
+  std::thread thread_;
+};
+
+// shards are assigned round-robin to ranks
+std::shared_ptr<DatasetLoader> get_dataset_loader(const YAML::Node& dataset_node, int rank = 0, int size = 1);
+
+// Train a model instance for the configured number of epochs on a dataset described in a YAML file
+void train_dataset(const char* name, const char* dataset_config_fname);
+
+} // namespace torchfort
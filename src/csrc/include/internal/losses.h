@@ -30,6 +30,7 @@
 
 #pragma once
 
+#include <variant>
 #include <vector>
 
 #include <torch/enum.h>
@@ -41,12 +42,28 @@
 
 namespace torchfort {
 
+// Reduce elementwise losses of shape [batch, n] to per-sample losses and the weighted batch loss,
+// following the sum or mean reduction of the loss options
+template <typename R>
+torch::Tensor reduce_weighted(const torch::Tensor& elementwise, const torch::Tensor& weights, const R& reduction,
+                              torch::Tensor& sample_losses) {
+  bool sum = std::holds_alternative<torch::enumtype::kSum>(reduction);
+  auto per_sample = sum ? elementwise.sum(1) : elementwise.mean(1);
+  sample_losses = per_sample.detach();
+  auto weighted = weights.to(per_sample.dtype()) * per_sample;
+  return sum ? weighted.sum() : weighted.mean();
+}
+
 struct L1Loss : BaseLoss {
   void setup(const ParamMap& params) override;
 
   std::vector<torch::Tensor> forward(const std::vector<torch::Tensor>& inputs,
                                      const std::vector<torch::Tensor>& labels) override;
 
+  std::vector<torch::Tensor> forward_weighted(const std::vector<torch::Tensor>& inputs,
+                                              const std::vector<torch::Tensor>& labels, const torch::Tensor& weights,
+                                              torch::Tensor& sample_losses) override;
+
   torch::nn::L1Loss module;
 };
 
@@ -56,6 +73,10 @@ struct MSELoss : BaseLoss {
   std::vector<torch::Tensor> forward(const std::vector<torch::Tensor>& inputs,
                                      const std::vector<torch::Tensor>& labels) override;
 
+  std::vector<torch::Tensor> forward_weighted(const std::vector<torch::Tensor>& inputs,
+                                              const std::vector<torch::Tensor>& labels, const torch::Tensor& weights,
+                                              torch::Tensor& sample_losses) override;
+
   torch::nn::MSELoss module;
 };
 
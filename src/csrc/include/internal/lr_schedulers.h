@@ -94,4 +94,26 @@ private:
   const double start_factor_, end_factor_;
 };
 
+enum BatchScalingRule { NoScaling = 0, LinearScaling = 1, SqrtScaling = 2 };
+
+// Grows the effective batch by growth_factor every step_size steps, up to max_factor times the configured batch
+// size. The learning rate follows the batch factor according to the scaling rule.
+class BatchGrowthLR : public BaseLRScheduler {
+public:
+  BatchGrowthLR(torch::optim::Optimizer& optimizer, const unsigned step_size, const unsigned growth_factor = 2,
+                const unsigned max_factor = 8, const BatchScalingRule scaling = LinearScaling);
+
+  int64_t batch_factor() const override;
+
+private:
+  std::vector<double> get_lrs() override;
+  int64_t factor_at(const int64_t step) const;
+
+  const unsigned step_size_;
+  const unsigned growth_factor_;
+  const unsigned max_factor_;
+  const BatchScalingRule scaling_;
+  std::vector<double> base_lrs_;
+};
+
 } // namespace torchfort
@@ -30,17 +30,28 @@
 
 #pragma once
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include <torch/torch.h>
 
+#include "internal/async_trainer.h"
 #include "internal/base_loss.h"
 #include "internal/base_lr_scheduler.h"
 #include "internal/distributed.h"
 #include "internal/model_state.h"
 #include "internal/model_wrapper.h"
+#include "internal/normalization.h"
+#include "internal/sample_store.h"
 
 namespace torchfort {
 
+// Hidden state of stateful models, kept per state stream between inference calls
+struct RecurrentState {
+  int64_t active_stream = 0;
+  std::unordered_map<int64_t, std::vector<torch::Tensor>> streams;
+};
+
 // Simple struct to group model, optimizer, lr scheduler, state, and comm objects
 struct ModelPack {
   std::shared_ptr<ModelWrapper> model;
@@ -49,6 +60,11 @@ struct ModelPack {
   std::shared_ptr<BaseLoss> loss;
   std::shared_ptr<Comm> comm;
   std::shared_ptr<ModelState> state;
+  std::shared_ptr<RecurrentState> recurrent_state;
+  std::shared_ptr<SampleStore> sample_store;
+  std::shared_ptr<Normalizer> normalizer;
+  // declared last, so the training thread is joined before the other members are destroyed
+  std::shared_ptr<AsyncTrainer> async_trainer;
 };
 
 void save_model_pack(const ModelPack& model_pack, const std::string& fname, bool save_optimizer = true);
@@ -34,6 +34,8 @@
 
 #include <torch/torch.h>
 
+#include "torchfort_enums.h"
+
 namespace torchfort {
 
 // Simple struct to store miscellaneous model state (e.g. iteration count)
@@ -48,6 +50,16 @@ struct ModelState {
   bool verbose;
   std::filesystem::path report_file;
 
+  // Episode statistics of reinforcement learning systems (collective on distributed systems)
+  bool track_episodes = false;
+
+  // Inference output of model ensembles
+  torchfort_ensemble_output_t ensemble_output = TORCHFORT_ENSEMBLE_MEAN;
+
+  // Gradient accumulation window of batch growth schedules: position and length (not checkpointed)
+  int64_t accumulation_step = 0;
+  int64_t accumulation_steps = 1;
+
   void save(const std::string& fname);
   void load(const std::string& fname);
 };
@@ -48,12 +48,21 @@ public:
 
   torch::OrderedDict<std::string, torch::Tensor> named_parameters() const;
 
+  // Parameters updated during training, i.e., all parameters not frozen by set_trainable_parameters.
+  std::vector<torch::Tensor> trainable_parameters() const;
+
+  // Freeze (requires_grad = false) all parameters whose names match none of the glob patterns. Kept across load.
+  void set_trainable_parameters(const std::vector<std::string>& patterns);
+
   void to(torch::Device device, bool non_blocking = false);
 
   void train();
 
   void eval();
 
+  // Evaluation mode with dropout layers left active, used for Monte Carlo dropout inference.
+  void eval_mc_dropout();
+
   std::vector<torch::Tensor> forward(const std::vector<torch::Tensor>& inputs) const;
 
   void save(const std::string& fname) const;
@@ -62,8 +71,32 @@ public:
 
   torch::Device device() const;
 
+  // Whether the model carries hidden state between forward calls (see BaseModel::stateful).
+  bool stateful() const;
+
+  void set_stateful(bool flag);
+
+  // Number of ensemble members stacked along the leading output dimension (see BaseModel::ensemble_size).
+  int ensemble_size() const;
+
+  // Access the underlying native model, nullptr for TorchScript models.
+  std::shared_ptr<BaseModel> native_model() const;
+
+  // Access the underlying TorchScript module, nullptr for native models.
+  std::shared_ptr<torch::jit::Module> jit_model() const;
+
+  // Recompute forward activations of TorchScript models in num_segments segments during backward,
+  // num_segments = 0 selects a default based on the number of layers.
+  void enable_activation_checkpointing(int num_segments);
+
 private:
+  std::vector<torch::Tensor> forward_jit_checkpointed(const std::vector<torch::Tensor>& inputs) const;
+  void apply_trainable_patterns();
+
   bool jit = false;
+  bool jit_stateful = false;
+  int checkpoint_segments = 0;
+  std::vector<std::string> trainable_patterns;
   std::shared_ptr<BaseModel> model;
   std::shared_ptr<torch::jit::Module> model_jit;
   torch::Device device_ = torch::Device(torch::kCPU);
@@ -30,6 +30,8 @@
 
 #pragma once
 
+#include <functional>
+#include <memory>
 #include <vector>
 
 #include <torch/torch.h>
@@ -44,13 +46,113 @@ namespace torchfort {
 struct MLPModel : BaseModel, public std::enable_shared_from_this<MLPModel> {
   void setup(const ParamMap& params) override;
   std::vector<torch::Tensor> forward(const std::vector<torch::Tensor>& inputs) override;
+  bool batched_ensemble() const override { return true; }
+  int ensemble_size() const override { return n_members; }
 
   double dropout;
   std::vector<int> layer_sizes;
+  bool checkpoint_activations;
+  int checkpoint_segments;
+  int n_members;
 
   // Use one of many "standard library" modules.
   std::vector<torch::nn::Linear> fc_layers;
   std::vector<torch::Tensor> biases;
+
+  // Stacked weights and biases of ensemble members.
+  std::vector<torch::Tensor> ensemble_weights;
+  std::vector<torch::Tensor> ensemble_biases;
+
+private:
+  torch::Tensor layer_forward(int i, const torch::Tensor& x);
+  std::vector<torch::Tensor> layer_parameters(int i) const;
+};
+
+// Fourier Neural Operator model in C++ using libtorch. Operates on channel-first fields
+// of shape [batch, channels, d_1, ..., d_k], which is the native layout of Fortran arrays
+// of shape (d_k, ..., d_1, channels, batch).
+struct FNOModel : BaseModel, public std::enable_shared_from_this<FNOModel> {
+  void setup(const ParamMap& params) override;
+  std::vector<torch::Tensor> forward(const std::vector<torch::Tensor>& inputs) override;
+
+  int in_channels;
+  int out_channels;
+  int width;
+  int projection_width;
+  int num_layers;
+  std::vector<int> modes;
+
+  // pointwise lifting and projection layers
+  torch::Tensor lift_weight, lift_bias;
+  torch::Tensor proj_weight, proj_bias;
+  torch::Tensor out_weight, out_bias;
+
+  // spectral weights of shape [n_modes, width, width, 2] and pointwise bypass per layer
+  std::vector<torch::Tensor> spectral_weights;
+  std::vector<torch::Tensor> bypass_weights;
+  std::vector<torch::Tensor> bypass_biases;
+
+private:
+  torch::Tensor spectral_conv(const torch::Tensor& x, const torch::Tensor& weight) const;
+};
+
+// Message-passing graph neural network model in C++ using libtorch. Operates on node features
+// of shape [n_nodes, channels] or [batch, n_nodes, channels]. The mesh connectivity is registered
+// once via set_graph and cached in the model.
+struct GNNModel : BaseModel, public std::enable_shared_from_this<GNNModel> {
+  void setup(const ParamMap& params) override;
+  std::vector<torch::Tensor> forward(const std::vector<torch::Tensor>& inputs) override;
+
+  // Register CSR connectivity: row i lists the neighbors sending messages to node i. Indices
+  // are offset by index_base (1 for Fortran).
+  void set_graph(int64_t n_nodes, torch::Tensor row_offsets, torch::Tensor col_indices, int64_t index_base = 0);
+
+  int in_channels;
+  int out_channels;
+  int hidden_channels;
+  int num_layers;
+  bool mean_aggregation;
+
+  torch::nn::Linear encoder = nullptr;
+  torch::nn::Linear decoder = nullptr;
+  // edge message and node update layers, split by source so that no concatenation is required
+  std::vector<torch::nn::Linear> msg_dst_layers, msg_src_layers;
+  std::vector<torch::nn::Linear> upd_node_layers, upd_agg_layers;
+
+private:
+  // cached graph, edges are stored in Z-order of (dst, src) for locality of gathers and scatters
+  int64_t n_nodes = 0;
+  torch::Tensor edge_src, edge_dst, inv_degree;
+};
+
+// Recurrent (LSTM/GRU) model in C++ using libtorch. Operates on sequences [batch, seq_len, features]
+// or single time steps [batch, features]. The hidden state is passed in and returned as additional tensors.
+struct RNNModel : BaseModel, public std::enable_shared_from_this<RNNModel> {
+  void setup(const ParamMap& params) override;
+  std::vector<torch::Tensor> forward(const std::vector<torch::Tensor>& inputs) override;
+  bool stateful() const override { return true; }
+
+  bool use_lstm;
+  int input_size;
+  int hidden_size;
+  int output_size;
+  int num_layers;
+  double dropout;
+
+  torch::nn::LSTM lstm = nullptr;
+  torch::nn::GRU gru = nullptr;
+  torch::nn::Linear head = nullptr;
+};
+
+// Ensemble of independently initialized native models, evaluated member by member. Used for
+// models which do not support batched ensembles. Outputs are stacked as [n_members, ...].
+struct EnsembleModel : BaseModel, public std::enable_shared_from_this<EnsembleModel> {
+  EnsembleModel(const std::function<std::shared_ptr<BaseModel>()>& factory, int n_members);
+  void setup(const ParamMap& params) override;
+  std::vector<torch::Tensor> forward(const std::vector<torch::Tensor>& inputs) override;
+  int ensemble_size() const override { return members.size(); }
+
+  std::vector<std::shared_ptr<BaseModel>> members;
 };
 
 // Creating model_registry.
@@ -58,6 +160,9 @@ BEGIN_MODEL_REGISTRY
 
 // Add entries for new models in this section.
 REGISTER_MODEL(MLP, MLPModel)
+REGISTER_MODEL(FNO, FNOModel)
+REGISTER_MODEL(GNN, GNNModel)
+REGISTER_MODEL(RNN, RNNModel)
 
 END_MODEL_REGISTRY
 
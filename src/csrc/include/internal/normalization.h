@@ -0,0 +1,109 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2023 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <torch/torch.h>
+#include <yaml-cpp/yaml.h>
+
+#include "internal/distributed.h"
+
+namespace torchfort {
+
+// Welford running mean and variance per sample element (or per channel) along the leading batch dimension.
+// Batches are merged into pending statistics, which are merged across ranks into the shared statistics on sync.
+class RunningStats {
+public:
+  RunningStats(bool per_channel, double eps, torch::Device device);
+
+  void update(const torch::Tensor& x);
+  void sync(const std::shared_ptr<Comm>& comm);
+
+  bool empty() const { return count_ == 0; }
+
+  // normalization x * scale + shift, broadcasting against samples
+  const torch::Tensor& scale() const { return scale_; }
+  const torch::Tensor& shift() const { return shift_; }
+  // de-normalization x * stddev + mean
+  const torch::Tensor& stddev() const { return stddev_; }
+  const torch::Tensor& mean() const { return mean_view_; }
+
+  void save(torch::serialize::OutputArchive& archive, const std::string& prefix) const;
+  void load(torch::serialize::InputArchive& archive, const std::string& prefix);
+
+private:
+  torch::Tensor flatten(const torch::Tensor& x) const;
+  void updateTransform();
+
+  bool per_channel_;
+  torch::Device device_;
+  double eps_;
+  std::vector<int64_t> view_shape_;
+
+  double count_ = 0;
+  torch::Tensor mean_, m2_;
+  double pending_count_ = 0;
+  torch::Tensor pending_mean_, pending_m2_;
+
+  torch::Tensor scale_, shift_, stddev_, mean_view_;
+};
+
+// Normalization of model inputs and labels with running statistics gathered from training batches
+class Normalizer {
+public:
+  Normalizer(bool normalize_inputs, bool normalize_labels, bool per_channel, double eps, int64_t sync_frequency,
+             torch::Device device);
+
+  // accumulate statistics of a training batch, merged across ranks every sync_frequency updates
+  void update(const torch::Tensor& inputs, const torch::Tensor& labels, const std::shared_ptr<Comm>& comm);
+
+  torch::Tensor normalizeInputs(const torch::Tensor& inputs) const;
+  torch::Tensor normalizeLabels(const torch::Tensor& labels) const;
+
+  // write de-normalized model output (or output variance) into out
+  void denormalizeOutput(const torch::Tensor& output, torch::Tensor& out, bool variance = false) const;
+
+  void save(const std::string& fname) const;
+  void load(const std::string& fname);
+
+private:
+  std::unique_ptr<RunningStats> input_stats_;
+  std::unique_ptr<RunningStats> label_stats_;
+  int64_t sync_frequency_;
+  int64_t n_updates_ = 0;
+};
+
+std::shared_ptr<Normalizer> get_normalizer(const YAML::Node& normalization_node, torch::Device device,
+                                           int64_t default_sync_frequency);
+
+} // namespace torchfort
@@ -0,0 +1,106 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2023 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <ATen/cuda/CUDAEvent.h>
+#include <torch/torch.h>
+#include <yaml-cpp/yaml.h>
+
+namespace torchfort {
+
+struct ModelPack;
+
+// Chain of registered model instances evaluated in a single inference call. Intermediate outputs stay in
+// library-owned tensors on the stage devices. With more than one micro-batch, every stage runs on its own
+// thread and stream, so that micro-batches flow through the stages concurrently.
+class Pipeline {
+public:
+  // reference to output output_index of stage stage_index, stage_index -1 refers to the pipeline input
+  using TensorRef = std::pair<int, int>;
+
+  struct Stage {
+    std::string name;
+    std::string model;
+    std::vector<TensorRef> inputs;
+    // resolved when the pipeline is created, stage threads must not look up the global model map
+    ModelPack* model_pack = nullptr;
+  };
+
+  Pipeline(std::vector<Stage> stages, TensorRef output, int micro_batches);
+  ~Pipeline();
+
+  // disable copy constructor
+  Pipeline(const Pipeline&) = delete;
+
+  // names of the model instances evaluated by the pipeline, without duplicates
+  std::vector<std::string> models() const;
+
+  // evaluates all stages on input, which resides on the device of the first stage, and writes the output into out
+  void run(const torch::Tensor& input, torch::Tensor& out);
+
+private:
+  std::vector<torch::Tensor> forwardStage(int s, const torch::Tensor& input,
+                                          const std::vector<std::vector<torch::Tensor>>& outputs) const;
+  void runMicroBatched(const torch::Tensor& input, torch::Tensor& out);
+  void worker(int s);
+
+  std::vector<Stage> stages_;
+  TensorRef output_;
+  int micro_batches_;
+
+  // scratch state of a micro-batched run, indexed by micro-batch and stage
+  std::vector<torch::Tensor> input_chunks_;
+  std::vector<std::vector<std::vector<torch::Tensor>>> outputs_;
+  std::vector<std::vector<std::shared_ptr<at::cuda::CUDAEvent>>> events_;
+  std::shared_ptr<at::cuda::CUDAEvent> input_ready_;
+
+  std::vector<std::deque<int>> queues_;
+  int n_done_ = 0;
+  bool stop_ = false;
+  std::exception_ptr error_;
+  std::mutex mutex_;
+  std::condition_variable queue_cv_;
+  std::condition_variable done_cv_;
+  std::vector<std::thread> threads_;
+};
+
+std::shared_ptr<Pipeline> get_pipeline(const YAML::Node& pipeline_node);
+
+} // namespace torchfort
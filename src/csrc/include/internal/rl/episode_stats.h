@@ -0,0 +1,109 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2023 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include <memory>
+
+#include <torch/torch.h>
+
+#include "internal/distributed.h"
+#include "internal/logging.h"
+#include "internal/model_state.h"
+
+namespace torchfort {
+
+namespace rl {
+
+// running episode statistics per environment. Returns and lengths of running episodes as well as the totals of
+// completed episodes stay on the device of the reward data, the host only sees them at report intervals.
+class EpisodeStatistics {
+
+public:
+  EpisodeStatistics() : update_count_(0) {}
+
+  // disable copy constructor
+  EpisodeStatistics(const EpisodeStatistics&) = delete;
+
+  // r holds one reward per environment, d terminates the episodes of all environments
+  void update(torch::Tensor r, bool d) {
+    torch::NoGradGuard no_grad;
+
+    auto rd = r.reshape({-1}).to(torch::kFloat64);
+    if (!episode_return_.defined() || (episode_return_.numel() != rd.numel()) ||
+        (episode_return_.device() != rd.device())) {
+      episode_return_ = torch::zeros_like(rd);
+      episode_length_ = torch::zeros_like(rd);
+      completed_ = torch::zeros({3}, rd.options());
+    }
+
+    episode_return_.add_(rd);
+    episode_length_.add_(1.);
+    if (d) {
+      // completed totals: sum of returns, sum of lengths, number of episodes
+      completed_[0].add_(episode_return_.sum());
+      completed_[1].add_(episode_length_.sum());
+      completed_[2].add_(static_cast<double>(rd.numel()));
+      episode_return_.zero_();
+      episode_length_.zero_();
+    }
+    update_count_++;
+  }
+
+  // aggregate completed episodes across ranks and log their mean return and length. This is a collective call if a
+  // communicator is present, all ranks need to perform the same number of updates.
+  void report(const char* name, std::shared_ptr<ModelState> state, std::shared_ptr<Comm> comm) {
+    if ((state->report_frequency <= 0) || (update_count_ % state->report_frequency != 0) || !completed_.defined()) {
+      return;
+    }
+
+    auto totals = completed_.to(torch::kCPU, /* non_blocking = */ false, /* copy = */ true);
+    completed_.zero_();
+    if (comm) {
+      comm->allreduce(totals, false);
+    }
+
+    auto totals_ptr = totals.data_ptr<double>();
+    if (totals_ptr[2] > 0.) {
+      wandb_log(state, comm, name, "episode_return", update_count_, totals_ptr[0] / totals_ptr[2]);
+      wandb_log(state, comm, name, "episode_length", update_count_, totals_ptr[1] / totals_ptr[2]);
+      wandb_log(state, comm, name, "episodes", update_count_, static_cast<int64_t>(totals_ptr[2]));
+    }
+  }
+
+private:
+  int64_t update_count_;
+  torch::Tensor episode_return_;
+  torch::Tensor episode_length_;
+  torch::Tensor completed_;
+};
+
+} // namespace rl
+
+} // namespace torchfort
@@ -29,6 +29,7 @@
  */
 
 #pragma once
+#include <algorithm>
 #include <unordered_map>
 
 #include <cuda_runtime.h>
@@ -57,6 +58,10 @@ public:
   virtual torch::Tensor operator()(const ModelPack&, torch::Tensor) = 0;
   virtual void printInfo() const = 0;
   virtual void freezeNoise(bool) = 0;
+
+  // restart the noise process of an environment (all environments for env_id < 0), e.g. at the end of an
+  // episode. Only noise with per-environment state implements this.
+  virtual void resetNoise(int64_t env_id) {}
 };
 
 // classical uncorrelated action space noise
@@ -122,12 +127,15 @@ protected:
 
 // classical correlated action space noise (OU noise)
 // dx_t = xi * (mu - x_t) * dt + sigma * N(0, sqrt(dt))
+// Every row of the action batch is an environment with its own noise process. The state of max_envs environments
+// is allocated on first use (max_envs = 0 sizes it to the first batch), batches may cover fewer environments.
 template <typename T> class ActionNoiseOU : public NoiseActor, public std::enable_shared_from_this<NoiseActor> {
 
 public:
-  ActionNoiseOU(const T& mu, const T& sigma, const T& clip, const T& dt, const T& xi, const bool& adaptive = false)
-      : mu_(mu), sigma_(sigma), clip_(clip), dt_(dt), xi_(xi), adaptive_(adaptive), initialized_(false),
-        freeze_(false) {
+  ActionNoiseOU(const T& mu, const T& sigma, const T& clip, const T& dt, const T& xi, const bool& adaptive = false,
+                const int64_t& max_envs = 0)
+      : mu_(mu), sigma_(sigma), clip_(clip), dt_(dt), xi_(xi), initialized_(false), freeze_(false),
+        adaptive_(adaptive), max_envs_(max_envs) {
     sqrtdt_ = static_cast<T>(std::sqrt(dt_));
   }
 
@@ -138,28 +146,43 @@ public:
     // get predictions
     auto action = policy.model->forward(std::vector<torch::Tensor>{state})[0];
 
-    T sigma_tmp = sigma_;
+    // adaptive sigma stays on the device, so that no synchronization is required
+    torch::Tensor sigma_tmp;
     if (adaptive_) {
-      sigma_tmp = sigma_ * torch::std(action, /* unbiased = */ false).item<T>();
+      sigma_tmp = sigma_ * torch::std(action, /* unbiased = */ false);
+      sigma_last_ = sigma_tmp;
     }
 
-    if (!initialized_) {
-      // get noise state
-      noise_state_ = torch::empty_like(action).normal_(mu_, sigma_tmp);
+    int64_t n_envs = action.size(0);
+    if (!noise_state_.defined()) {
+      // get noise state for all environments
+      auto shape = action.sizes().vec();
+      shape[0] = std::max(max_envs_, n_envs);
+      noise_state_ = torch::empty(shape, action.options());
+      initNoise(noise_state_);
       initialized_ = true;
     } else if (!freeze_) {
-      // update noise state
-      torch::Tensor dnoise =
-          xi_ * (mu_ - noise_state_) * dt_ + sigma_tmp * torch::empty_like(action).normal_(static_cast<T>(0.), sqrtdt_);
-      noise_state_ = noise_state_ + dnoise;
+      if (n_envs > noise_state_.size(0) || action.sizes().slice(1) != noise_state_.sizes().slice(1)) {
+        THROW_INVALID_USAGE("Action batch does not match the OU noise state, increase max_envs.");
+      }
+      // update noise state: mean reversion and diffusion are applied in place, one elementwise kernel each
+      auto noise_state = noise_state_.narrow(0, 0, n_envs);
+      auto eps = torch::randn_like(noise_state);
+      noise_state.lerp_(torch::full({}, mu_, action.options()), xi_ * dt_);
+      if (adaptive_) {
+        noise_state.addcmul_(eps, sigma_tmp, sqrtdt_);
+      } else {
+        noise_state.add_(eps, sigma_ * sqrtdt_);
+      }
     }
+    auto noise_state = noise_state_.narrow(0, 0, n_envs);
 
     // apply noise
     torch::Tensor noise;
     if (clip_ > 0) {
-      noise = torch::clamp(noise_state_, -clip_, clip_);
+      noise = torch::clamp(noise_state, -clip_, clip_);
     } else {
-      noise = noise_state_;
+      noise = noise_state;
     }
 
     // add noise to action
@@ -168,6 +191,20 @@ public:
     return action;
   }
 
+  void resetNoise(int64_t env_id) override {
+    if (!initialized_) {
+      return;
+    }
+    if (env_id < 0) {
+      initNoise(noise_state_);
+    } else if (env_id < noise_state_.size(0)) {
+      auto env_state = noise_state_[env_id];
+      initNoise(env_state);
+    } else {
+      THROW_INVALID_USAGE("Environment id exceeds the size of the OU noise state.");
+    }
+  }
+
   void printInfo() const {
     std::cout << "OU action noise parameters:" << std::endl;
     std::cout << "mu = " << mu_ << std::endl;
@@ -175,6 +212,7 @@ public:
     std::cout << "clip = " << clip_ << std::endl;
     std::cout << "dt = " << dt_ << std::endl;
     std::cout << "xi = " << xi_ << std::endl;
+    std::cout << "max_envs = " << max_envs_ << std::endl;
   }
 
   void freezeNoise(bool freeze) {
@@ -183,6 +221,15 @@ public:
   }
 
 protected:
+  // draw from N(mu, sigma), using the most recent adaptive sigma if enabled
+  void initNoise(torch::Tensor& x) {
+    if (adaptive_) {
+      x.copy_(torch::randn_like(x).mul_(sigma_last_).add_(mu_));
+    } else {
+      x.normal_(mu_, sigma_);
+    }
+  }
+
   T mu_;
   T sigma_;
   T clip_;
@@ -191,7 +238,9 @@ protected:
   bool initialized_;
   bool freeze_;
   bool adaptive_;
+  int64_t max_envs_;
   torch::Tensor noise_state_;
+  torch::Tensor sigma_last_;
 };
 
 // uncorrelated parameter space noise
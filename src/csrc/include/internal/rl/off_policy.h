@@ -41,6 +41,8 @@
 
 #include "internal/defines.h"
 #include "internal/logging.h"
+#include "internal/rl/episode_stats.h"
+#include "internal/rl/policy_sync.h"
 
 namespace torchfort {
 
@@ -61,7 +63,9 @@ public:
 
   // some important functions which have to be implemented by the base class
   virtual void updateReplayBuffer(torch::Tensor, torch::Tensor, torch::Tensor, float, bool) = 0;
+  virtual void updateReplayBufferMultiAgent(torch::Tensor, torch::Tensor, torch::Tensor, torch::Tensor, bool) = 0;
   virtual bool isReady() = 0;
+  virtual void resetExplorationNoise(int64_t env_id) {}
 
   // these have to be implemented
   virtual torch::Tensor explore(torch::Tensor) = 0;
@@ -73,19 +77,58 @@ public:
   virtual void initSystemComm(MPI_Comm mpi_comm) = 0;
   virtual void saveCheckpoint(const std::string& checkpoint_dir) const = 0;
   virtual void loadCheckpoint(const std::string& checkpoint_dir) = 0;
+  virtual void exportPolicy(const std::string& fname) const = 0;
   virtual torch::Device modelDevice() const = 0;
   virtual torch::Device rbDevice() const = 0;
 
+  // episode statistics from the rewards and terminal flags passed to the buffer updates
+  void trackEpisodes(const char* name, torch::Tensor r, bool d);
+
+  // replay ratio scheduling: accumulates update credit for new transitions and runs the owed train steps
+  void scheduleUpdates(int64_t n_transitions);
+
+  // actor-only ranks of asynchronous policy replication do not train
+  bool isLearner() const { return !policy_sync_ || policy_sync_->learner(); }
+
+  // collective shutdown of asynchronous policy replication, required before MPI is finalized
+  void stopPolicySync();
+
 protected:
   virtual std::shared_ptr<ModelState> getSystemState_() = 0;
   virtual std::shared_ptr<Comm> getSystemComm_() = 0;
   size_t train_step_count_;
   torch::Device model_device_, rb_device_;
+  EpisodeStatistics episode_stats_;
+  // train steps per environment transition, 0 disables scheduling
+  float replay_ratio_;
+  // minimum number of owed train steps before they are executed
+  int update_granularity_;
+  double update_credit_;
+  // sets up policy replication if enabled, returns the communicator this rank trains with
+  MPI_Comm initPolicySync_(MPI_Comm mpi_comm);
+  // train steps between policy broadcasts to actor-only ranks, 0 disables replication
+  int policy_sync_interval_;
+  int num_learners_;
+  std::shared_ptr<PolicySync> policy_sync_;
 };
 
 // Declaration of external global variables
 extern std::unordered_map<std::string, std::shared_ptr<RLOffPolicySystem>> registry;
 
+// run the train steps owed for n_transitions new transitions on the model stream
+inline void schedule_updates(const char* name, int64_t n_transitions, cudaStream_t ext_stream) {
+  // callers hold a no grad guard for the replay buffer update
+  torch::AutoGradMode enable_grad(true);
+
+  c10::cuda::OptionalCUDAStreamGuard guard;
+  auto model_device = registry[name]->modelDevice();
+  if (model_device.is_cuda()) {
+    auto stream = c10::cuda::getStreamFromExternal(ext_stream, model_device.index());
+    guard.reset_stream(stream);
+  }
+  registry[name]->scheduleUpdates(n_transitions);
+}
+
 // some convenience wrappers
 template <MemoryLayout L, typename T>
 static void update_replay_buffer(const char* name, T* state_old, T* state_new, size_t state_dim, int64_t* state_shape,
@@ -112,6 +155,46 @@ static void update_replay_buffer(const char* name, T* state_old, T* state_new, s
 
   registry[name]->updateReplayBuffer(state_old_tensor, action_old_tensor, state_new_tensor,
 				     static_cast<float>(reward), final_state);
+  registry[name]->trackEpisodes(name, torch::full({1}, static_cast<double>(reward), torch::kFloat64), final_state);
+
+  schedule_updates(name, 1, ext_stream);
+  return;
+}
+
+// multi-agent variant: the leading dimension of the state and action data is the agent index, and reward points to
+// one value per agent
+template <MemoryLayout L, typename T>
+static void update_replay_buffer_multi_agent(const char* name, T* state_old, T* state_new, size_t state_dim,
+                                             int64_t* state_shape, T* action_old, size_t action_dim,
+                                             int64_t* action_shape, const T* reward, bool final_state,
+                                             cudaStream_t ext_stream) {
+
+  // no grad
+  torch::NoGradGuard no_grad;
+
+  c10::cuda::OptionalCUDAStreamGuard guard;
+  auto rb_device = registry[name]->rbDevice();
+  if (rb_device.is_cuda()) {
+    auto stream = c10::cuda::getStreamFromExternal(ext_stream, rb_device.index());
+    guard.reset_stream(stream);
+  }
+
+  // get tensors and copy:
+  auto state_old_tensor = get_tensor<L>(state_old, state_dim, state_shape)
+                              .to(torch::kFloat32, /* non_blocking = */ false, /* copy = */ true);
+  auto state_new_tensor = get_tensor<L>(state_new, state_dim, state_shape)
+                              .to(torch::kFloat32, /* non_blocking = */ false, /* copy = */ true);
+  auto action_old_tensor = get_tensor<L>(action_old, action_dim, action_shape)
+                               .to(torch::kFloat32, /* non_blocking = */ false, /* copy = */ true);
+  int64_t n_agents = state_old_tensor.size(0);
+  auto reward_tensor = get_tensor<RowMajor>(const_cast<T*>(reward), 1, &n_agents)
+                           .to(torch::kFloat32, /* non_blocking = */ false, /* copy = */ true);
+
+  registry[name]->updateReplayBufferMultiAgent(state_old_tensor, action_old_tensor, state_new_tensor, reward_tensor,
+                                               final_state);
+  registry[name]->trackEpisodes(name, reward_tensor, final_state);
+
+  schedule_updates(name, n_agents, ext_stream);
   return;
 }
 
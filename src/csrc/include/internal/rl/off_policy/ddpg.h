@@ -94,13 +94,8 @@ void train_ddpg(const ModelPack& p_model, const ModelPack& p_model_target, const
 
   // policy function
   // compute y: use the target models for q_new, no grads
-  torch::Tensor y_tensor;
-  {
-    torch::NoGradGuard no_grad;
-    auto q_new_tensor =
-        q_model_target.model->forward(std::vector<torch::Tensor>{state_new_tensor, action_new_tensor})[0];
-    y_tensor = torch::Tensor(reward_tensor + q_new_tensor * gamma * (1. - d_tensor));
-  }
+  torch::Tensor y_tensor = bellman_target(std::vector<ModelPack>{q_model_target}, state_new_tensor, action_new_tensor,
+                                          reward_tensor, d_tensor, gamma);
 
   // backward and update step
   // compute loss
@@ -224,7 +219,9 @@ public:
 
   // we should pass a tuple (s, a, s', r, d)
   void updateReplayBuffer(torch::Tensor s, torch::Tensor a, torch::Tensor sp, float r, bool d);
+  void updateReplayBufferMultiAgent(torch::Tensor s, torch::Tensor a, torch::Tensor sp, torch::Tensor r, bool d);
   bool isReady();
+  void resetExplorationNoise(int64_t env_id);
 
   // train step
   void trainStep(float& p_loss_val, float& q_loss_val);
@@ -237,6 +234,7 @@ public:
 
   // saving and loading
   void saveCheckpoint(const std::string& checkpoint_dir) const;
+  void exportPolicy(const std::string& fname) const;
   void loadCheckpoint(const std::string& checkpoint_dir);
 
   // info printing
@@ -251,6 +249,7 @@ private:
   std::shared_ptr<ModelState> getSystemState_();
 
   std::shared_ptr<Comm> getSystemComm_();
+  void receivePolicy_();
 
   // internally used functions
   torch::Tensor predictWithNoiseTrain_(torch::Tensor state);
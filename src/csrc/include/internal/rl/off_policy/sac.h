@@ -101,41 +101,41 @@ void train_sac(const PolicyPack& p_model, const std::vector<ModelPack>& q_models
     std::tie(action_new_tensor, action_new_log_prob) = p_model.model->forwardNoise(state_new_tensor);
 
     // compute expected reward
-    torch::Tensor q_new_tensor =
-        q_models_target[0].model->forward(std::vector<torch::Tensor>{state_new_tensor, action_new_tensor})[0];
-    for (int i = 1; i < q_models_target.size(); ++i) {
-      torch::Tensor q_tmp_tensor =
-          q_models_target[i].model->forward(std::vector<torch::Tensor>{state_new_tensor, action_new_tensor})[0];
-      q_new_tensor = torch::minimum(q_new_tensor, q_tmp_tensor);
-    }
-    y_tensor = torch::Tensor(reward_tensor + (q_new_tensor - alpha * action_new_log_prob) * gamma * (1. - d_tensor));
+    y_tensor = bellman_target(q_models_target, state_new_tensor, action_new_tensor, reward_tensor, d_tensor, gamma,
+                              action_new_log_prob, alpha);
   }
 
   // backward and update step
-  q_loss_vals.clear();
+  // the critics are independent given y, so all backward passes are done before the updates
+  std::vector<torch::Tensor> q_loss_tensors;
   for (const auto& q_model : q_models) {
     // compute loss
     auto q_old_tensor = q_model.model->forward(std::vector<torch::Tensor>{state_old_tensor, action_old_tensor})[0];
     auto q_loss_tensor = q_loss_func->forward(q_old_tensor, y_tensor);
     q_model.optimizer->zero_grad();
     q_loss_tensor.backward();
+    q_loss_tensors.push_back(q_loss_tensor);
+  }
 
-    // grad comm
-    if (q_model.comm) {
-      std::vector<torch::Tensor> grads;
-      grads.reserve(q_model.model->parameters().size());
+  // grad comm: the gradients of all critics are averaged in a single coalesced allreduce
+  if (q_models[0].comm) {
+    std::vector<torch::Tensor> grads;
+    for (const auto& q_model : q_models) {
       for (const auto& p : q_model.model->parameters()) {
         grads.push_back(p.grad());
       }
-      q_model.comm->allreduce(grads, true);
     }
+    q_models[0].comm->allreduce(grads, true);
+  }
 
+  q_loss_vals.clear();
+  for (size_t i = 0; i < q_models.size(); ++i) {
     // optimizer step
-    q_model.optimizer->step();
-    q_model.lr_scheduler->step();
+    q_models[i].optimizer->step();
+    q_models[i].lr_scheduler->step();
 
     // save loss values
-    q_loss_vals.push_back(q_loss_tensor.item<T>());
+    q_loss_vals.push_back(q_loss_tensors[i].item<T>());
   }
 
   // policy function
@@ -254,6 +254,7 @@ public:
 
   // we should pass a tuple (s, a, s', r, d)
   void updateReplayBuffer(torch::Tensor s, torch::Tensor a, torch::Tensor sp, float r, bool d);
+  void updateReplayBufferMultiAgent(torch::Tensor s, torch::Tensor a, torch::Tensor sp, torch::Tensor r, bool d);
   bool isReady();
 
   // train step
@@ -267,6 +268,7 @@ public:
 
   // saving and loading
   void saveCheckpoint(const std::string& checkpoint_dir) const;
+  void exportPolicy(const std::string& fname) const;
   void loadCheckpoint(const std::string& checkpoint_dir);
 
   // info printing
@@ -281,6 +283,7 @@ private:
   std::shared_ptr<ModelState> getSystemState_();
 
   std::shared_ptr<Comm> getSystemComm_();
+  void receivePolicy_();
 
   // models
   PolicyPack p_model_;
@@ -101,18 +101,8 @@ void train_td3(const ModelPack& p_model, const ModelPack& p_model_target, const
 
   // policy function
   // compute y: use the target models for q_new, no grads
-  torch::Tensor y_tensor;
-  {
-    torch::NoGradGuard no_grad;
-    torch::Tensor q_new_tensor =
-        q_models_target[0].model->forward(std::vector<torch::Tensor>{state_new_tensor, action_new_tensor})[0];
-    for (int i = 1; i < q_models_target.size(); ++i) {
-      torch::Tensor q_tmp_tensor =
-          q_models_target[i].model->forward(std::vector<torch::Tensor>{state_new_tensor, action_new_tensor})[0];
-      q_new_tensor = torch::minimum(q_new_tensor, q_tmp_tensor);
-    }
-    y_tensor = torch::Tensor(reward_tensor + q_new_tensor * gamma * (1. - d_tensor));
-  }
+  torch::Tensor y_tensor =
+      bellman_target(q_models_target, state_new_tensor, action_new_tensor, reward_tensor, d_tensor, gamma);
 
   // backward and update step
   // compute loss for critics and zero grads while we are at it
@@ -126,31 +116,27 @@ void train_td3(const ModelPack& p_model, const ModelPack& p_model_target, const
   }
   q_loss_tensor.backward();
 
-  // update critics
-  for (const auto& q_model : q_models) {
-    // grad comm
-    if (q_model.comm) {
-      std::vector<torch::Tensor> grads;
-      grads.reserve(q_model.model->parameters().size());
+  // grad comm: the gradients of all critics and the loss value are averaged in a single coalesced allreduce
+  torch::Tensor q_loss_mean_tensor = q_loss_tensor.detach();
+  if (q_models[0].comm) {
+    std::vector<torch::Tensor> grads;
+    for (const auto& q_model : q_models) {
       for (const auto& p : q_model.model->parameters()) {
         grads.push_back(p.grad());
       }
-      q_model.comm->allreduce(grads, true);
     }
+    grads.push_back(q_loss_mean_tensor);
+    q_models[0].comm->allreduce(grads, true);
+  }
 
+  // update critics
+  for (const auto& q_model : q_models) {
     // optimizer step
     q_model.optimizer->step();
     q_model.lr_scheduler->step();
   }
 
   // save loss values
-  torch::Tensor q_loss_mean_tensor = q_loss_tensor;
-  if (q_models[0].comm) {
-    torch::NoGradGuard no_grad;
-    std::vector<torch::Tensor> q_loss_mean = {q_loss_tensor};
-    q_models[0].comm->allreduce(q_loss_mean, true);
-    q_loss_mean_tensor = q_loss_mean[0];
-  }
   q_loss_val = q_loss_mean_tensor.item<T>();
 
   // policy function
@@ -170,13 +156,15 @@ void train_td3(const ModelPack& p_model, const ModelPack& p_model_target, const
     p_model.optimizer->zero_grad();
     p_loss_tensor.backward();
 
-    // allreduce (average) gradients (if running distributed)
+    // allreduce (average) gradients and the loss value for printing (if running distributed)
+    torch::Tensor p_loss_mean_tensor = p_loss_tensor.detach();
     if (p_model.comm) {
       std::vector<torch::Tensor> grads;
-      grads.reserve(p_model.model->parameters().size());
+      grads.reserve(p_model.model->parameters().size() + 1);
       for (const auto& p : p_model.model->parameters()) {
         grads.push_back(p.grad());
       }
+      grads.push_back(p_loss_mean_tensor);
       p_model.comm->allreduce(grads, true);
     }
 
@@ -187,14 +175,6 @@ void train_td3(const ModelPack& p_model, const ModelPack& p_model_target, const
     // unfreeze the q1model
     set_grad_state(q_models[0].model, true);
 
-    // reduce losses across ranks for printing
-    torch::Tensor p_loss_mean_tensor = p_loss_tensor;
-    if (p_model.comm) {
-      torch::NoGradGuard no_grad;
-      std::vector<torch::Tensor> p_loss_mean = {p_loss_tensor};
-      p_model.comm->allreduce(p_loss_mean, true);
-      p_loss_mean_tensor = p_loss_mean[0];
-    }
     p_loss_val = p_loss_mean_tensor.item<T>();
   } else {
     // make sure that the loss value is sane and not some garbage number
@@ -266,7 +246,9 @@ public:
 
   // we should pass a tuple (s, a, s', r, d)
   void updateReplayBuffer(torch::Tensor s, torch::Tensor a, torch::Tensor sp, float r, bool d);
+  void updateReplayBufferMultiAgent(torch::Tensor s, torch::Tensor a, torch::Tensor sp, torch::Tensor r, bool d);
   bool isReady();
+  void resetExplorationNoise(int64_t env_id);
 
   // train step
   void trainStep(float& p_loss_val, float& q_loss_val);
@@ -279,6 +261,7 @@ public:
 
   // saving and loading
   void saveCheckpoint(const std::string& checkpoint_dir) const;
+  void exportPolicy(const std::string& fname) const;
   void loadCheckpoint(const std::string& checkpoint_dir);
 
   // info printing
@@ -293,6 +276,7 @@ private:
   std::shared_ptr<ModelState> getSystemState_();
 
   std::shared_ptr<Comm> getSystemComm_();
+  void receivePolicy_();
 
   // internally used functions
   torch::Tensor predictWithNoiseTrain_(torch::Tensor state);
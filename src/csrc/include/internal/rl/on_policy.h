@@ -41,6 +41,7 @@
 
 #include "internal/defines.h"
 #include "internal/logging.h"
+#include "internal/rl/episode_stats.h"
 
 namespace torchfort {
 
@@ -75,14 +76,19 @@ public:
   virtual void initSystemComm(MPI_Comm mpi_comm) = 0;
   virtual void saveCheckpoint(const std::string& checkpoint_dir) const = 0;
   virtual void loadCheckpoint(const std::string& checkpoint_dir) = 0;
+  virtual void exportPolicy(const std::string& fname) const = 0;
   virtual torch::Device modelDevice() const = 0;
   virtual torch::Device rbDevice() const = 0;
 
+  // episode statistics from the rewards and terminal flags passed to the buffer updates
+  void trackEpisodes(const char* name, torch::Tensor r, bool d);
+
 protected:
   virtual std::shared_ptr<ModelState> getSystemState_() = 0;
   virtual std::shared_ptr<Comm> getSystemComm_() = 0;
   size_t train_step_count_;
   torch::Device model_device_, rb_device_;
+  EpisodeStatistics episode_stats_;
 };
 
 // Declaration of external global variables
@@ -118,6 +124,7 @@ static void update_rollout_buffer(const char* name, T* state, size_t state_dim,
   registry[name]->updateRolloutBuffer(state_tensor, action_tensor, 
 			 	      static_cast<float>(reward),
 				      final_state);
+  registry[name]->trackEpisodes(name, torch::full({1}, static_cast<double>(reward), torch::kFloat64), final_state);
   return;
 }
 
@@ -295,6 +295,7 @@ public:
 
   // saving and loading
   void saveCheckpoint(const std::string& checkpoint_dir) const;
+  void exportPolicy(const std::string& fname) const;
   void loadCheckpoint(const std::string& checkpoint_dir);
 
   // info printing
@@ -76,6 +76,10 @@ public:
   virtual std::tuple<torch::Tensor, torch::Tensor> evaluateAction(torch::Tensor state, torch::Tensor action) = 0;
   virtual std::tuple<torch::Tensor, torch::Tensor> forwardNoise(torch::Tensor state) = 0;
   virtual torch::Tensor forwardDeterministic(torch::Tensor state) = 0;
+
+  // underlying network and output squashing, used for policy export
+  virtual std::shared_ptr<ModelWrapper> network() const = 0;
+  virtual bool squashed() const = 0;
 };
 
 struct PolicyPack {
@@ -105,6 +109,9 @@ public:
   std::tuple<torch::Tensor, torch::Tensor> forwardNoise(torch::Tensor state);
   torch::Tensor forwardDeterministic(torch::Tensor state);
 
+  std::shared_ptr<ModelWrapper> network() const { return p_mu_log_sigma_; }
+  bool squashed() const { return squashed_; }
+
 protected:
   std::shared_ptr<NormalDistribution> getDistribution_(torch::Tensor state);
   
@@ -135,6 +142,10 @@ public:
   virtual std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> evaluateAction(torch::Tensor state, torch::Tensor action) = 0;
   virtual std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> forwardNoise(torch::Tensor state) = 0;
   virtual std::tuple<torch::Tensor, torch::Tensor> forwardDeterministic(torch::Tensor state) = 0;
+
+  // underlying network and output squashing, used for policy export
+  virtual std::shared_ptr<ModelWrapper> network() const = 0;
+  virtual bool squashed() const = 0;
 };
 
 struct ACPolicyPack {
@@ -165,6 +176,9 @@ public:
   std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> forwardNoise(torch::Tensor state);
   std::tuple<torch::Tensor, torch::Tensor> forwardDeterministic(torch::Tensor state);
 
+  std::shared_ptr<ModelWrapper> network() const { return p_mu_log_sigma_value_; }
+  bool squashed() const { return squashed_; }
+
 protected:
   std::tuple<std::shared_ptr<NormalDistribution>, torch::Tensor> getDistributionValue_(torch::Tensor state);
 
@@ -174,7 +188,12 @@ protected:
   std::shared_ptr<ModelWrapper> p_mu_log_sigma_value_;
 };
 
-  
+// Export the deterministic action of a policy network as a single frozen TorchScript module: the first output of
+// model, tanh squashed if requested, then mapped from [-1, 1] to [a_low, a_high] (Scale) or clipped to it (Clip).
+// Supports TorchScript networks and native MLP models. The module is written to fname with parameters on the CPU.
+void export_policy(const std::string& fname, std::shared_ptr<ModelWrapper> model, bool squashed,
+                   ActorNormalizationMode mode, float a_low, float a_high);
+
 } // namespace rl
 
 } // namespace torchfort
@@ -0,0 +1,206 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2023 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include <vector>
+
+#include <mpi.h>
+
+#include <torch/torch.h>
+
+#include "internal/defines.h"
+
+namespace torchfort {
+
+namespace rl {
+
+// Asynchronous replication of the policy from the learner ranks to actor-only ranks. Ranks below num_learners train,
+// the remaining ranks only act and hold a policy replica. Rank 0 publishes its flattened policy parameters with a
+// non-blocking broadcast every interval train steps. Actor ranks receive into a host shadow buffer and swap it into
+// their policy once the broadcast completed, they never wait on the communication. Rank 0 skips a publication if
+// the previous one has not completed yet, so it does not wait on actors either.
+class PolicySync {
+
+public:
+  PolicySync(MPI_Comm mpi_comm, int interval, int num_learners)
+      : interval_(interval), num_learners_(num_learners), update_count_(0), request_(MPI_REQUEST_NULL),
+        sync_comm_(MPI_COMM_NULL), train_comm_(MPI_COMM_NULL) {
+    CHECK_MPI(MPI_Comm_rank(mpi_comm, &rank_));
+    // learners and actors train in separate groups, actors do not participate in gradient reductions
+    CHECK_MPI(MPI_Comm_split(mpi_comm, (learner() ? 0 : 1), rank_, &train_comm_));
+    // only rank 0 and the actors take part in the replication, rank 0 is rank 0 of this communicator as well
+    CHECK_MPI(MPI_Comm_split(mpi_comm, ((rank_ == 0) || !learner()) ? 0 : MPI_UNDEFINED, rank_, &sync_comm_));
+  }
+
+  // the replication has to be stopped with the collective stop before MPI is finalized
+  ~PolicySync() {
+    int finalized;
+    MPI_Finalized(&finalized);
+    if (!finalized) {
+      if (sync_comm_ != MPI_COMM_NULL) {
+        MPI_Comm_free(&sync_comm_);
+      }
+      MPI_Comm_free(&train_comm_);
+    }
+  }
+
+  // disable copy constructor
+  PolicySync(const PolicySync&) = delete;
+
+  bool learner() const { return rank_ < num_learners_; }
+
+  // communicator of the group this rank trains with
+  MPI_Comm trainComm() const { return train_comm_; }
+
+  // Collective over all ranks. Replaces the policy of the actors by the one of rank 0 and starts the replication.
+  void initialize(const std::vector<torch::Tensor>& parameters) {
+    if (sync_comm_ == MPI_COMM_NULL) {
+      return;
+    }
+    torch::NoGradGuard no_grad;
+
+    int64_t numel = 0;
+    for (const auto& p : parameters) {
+      numel += p.numel();
+    }
+    // the trailing entry signals the end of the replication
+    auto options = torch::TensorOptions().dtype(torch::kFloat32).device(torch::kCPU);
+    buffer_ = torch::zeros({numel + 1}, options.pinned_memory(parameters.front().is_cuda()));
+
+    if (learner()) {
+      pack(parameters);
+    }
+    CHECK_MPI(MPI_Bcast(buffer_.data_ptr(), static_cast<int>(buffer_.numel()), MPI_FLOAT, 0, sync_comm_));
+    if (!learner()) {
+      unpack(parameters);
+      post();
+    }
+  }
+
+  // Learner ranks call this after every train step, actor ranks before acting. Returns true if a new policy was
+  // swapped into the parameters.
+  bool sync(const std::vector<torch::Tensor>& parameters) {
+    if (sync_comm_ == MPI_COMM_NULL) {
+      return false;
+    }
+    torch::NoGradGuard no_grad;
+
+    int flag;
+    if (learner()) {
+      // publish every interval train steps, unless the actors still receive the previous policy
+      if (++update_count_ % interval_ != 0) {
+        return false;
+      }
+      CHECK_MPI(MPI_Test(&request_, &flag, MPI_STATUS_IGNORE));
+      if (!flag) {
+        return false;
+      }
+      pack(parameters);
+      post();
+      return false;
+    }
+
+    // actors: swap in the received policy and post the receive for the next one
+    if (request_ == MPI_REQUEST_NULL) {
+      return false;
+    }
+    CHECK_MPI(MPI_Test(&request_, &flag, MPI_STATUS_IGNORE));
+    if (!flag) {
+      return false;
+    }
+    if (stopped()) {
+      return false;
+    }
+    unpack(parameters);
+    post();
+    return true;
+  }
+
+  // Collective over all ranks. Rank 0 sends a final stop message which the actors drain their pending receives up
+  // to, afterwards no communication is pending and the policy replicas stay as they are.
+  void stop() {
+    if (sync_comm_ == MPI_COMM_NULL) {
+      return;
+    }
+    if (learner()) {
+      CHECK_MPI(MPI_Wait(&request_, MPI_STATUS_IGNORE));
+      buffer_[-1].fill_(1.);
+      post();
+      CHECK_MPI(MPI_Wait(&request_, MPI_STATUS_IGNORE));
+    } else {
+      while (request_ != MPI_REQUEST_NULL) {
+        CHECK_MPI(MPI_Wait(&request_, MPI_STATUS_IGNORE));
+        if (!stopped()) {
+          post();
+        }
+      }
+    }
+    CHECK_MPI(MPI_Comm_free(&sync_comm_));
+  }
+
+private:
+  bool stopped() const { return buffer_[-1].item<float>() != 0.; }
+
+  void post() {
+    CHECK_MPI(MPI_Ibcast(buffer_.data_ptr(), static_cast<int>(buffer_.numel()), MPI_FLOAT, 0, sync_comm_, &request_));
+  }
+
+  void pack(const std::vector<torch::Tensor>& parameters) {
+    int64_t offset = 0;
+    for (const auto& p : parameters) {
+      buffer_.narrow(0, offset, p.numel()).copy_(p.reshape({-1}));
+      offset += p.numel();
+    }
+  }
+
+  // synchronous copy, the receive for the next policy reuses the shadow buffer
+  void unpack(const std::vector<torch::Tensor>& parameters) {
+    int64_t offset = 0;
+    for (const auto& p : parameters) {
+      p.copy_(buffer_.narrow(0, offset, p.numel()).view_as(p));
+      offset += p.numel();
+    }
+  }
+
+  int interval_;
+  int num_learners_;
+  int rank_;
+  int64_t update_count_;
+  MPI_Request request_;
+  // rank 0 and the actor ranks, MPI_COMM_NULL on the other learners
+  MPI_Comm sync_comm_;
+  MPI_Comm train_comm_;
+  // flat host copy of the policy parameters followed by the stop flag
+  torch::Tensor buffer_;
+};
+
+} // namespace rl
+
+} // namespace torchfort
@@ -30,8 +30,12 @@
 
 #pragma once
 #include <deque>
+#include <memory>
 #include <random>
+#include <string>
 #include <tuple>
+#include <utility>
+#include <vector>
 
 #include <cuda_runtime.h>
 
@@ -40,7 +44,9 @@
 #include <torch/torch.h>
 
 #include "internal/defines.h"
+#include "internal/exceptions.h"
 #include "internal/rl/rl.h"
+#include "internal/spill_file.h"
 
 namespace torchfort {
 
@@ -50,6 +56,19 @@ using BufferEntry = std::tuple<torch::Tensor, torch::Tensor, torch::Tensor, floa
 
 enum RewardReductionMode { Sum = 1, Mean = 2, WeightedMean = 3, SumNoSkip = 4, MeanNoSkip = 5, WeightedMeanNoSkip = 6 };
 
+// splits a reward reduction mode into the reduction applied to n-step rollouts and whether incomplete rollouts are
+// skipped
+inline std::pair<RewardReductionMode, bool> split_reward_reduction_mode(RewardReductionMode reward_reduction_mode) {
+  if (reward_reduction_mode == RewardReductionMode::MeanNoSkip) {
+    return std::make_pair(RewardReductionMode::Mean, false);
+  } else if (reward_reduction_mode == RewardReductionMode::WeightedMeanNoSkip) {
+    return std::make_pair(RewardReductionMode::WeightedMean, false);
+  } else if (reward_reduction_mode == RewardReductionMode::SumNoSkip) {
+    return std::make_pair(RewardReductionMode::Sum, false);
+  }
+  return std::make_pair(reward_reduction_mode, true);
+}
+
 // abstract base class for replay buffer
 class ReplayBuffer {
 public:
@@ -60,6 +79,7 @@ public:
 
   // virtual functions
   virtual void update(torch::Tensor, torch::Tensor, torch::Tensor, float, bool) = 0;
+  virtual void updateMultiAgent(torch::Tensor, torch::Tensor, torch::Tensor, torch::Tensor, bool) = 0;
   virtual std::tuple<torch::Tensor, torch::Tensor, torch::Tensor, torch::Tensor, torch::Tensor>
   sample(int) = 0;
   virtual bool isReady() const = 0;
@@ -81,22 +101,10 @@ public:
   UniformReplayBuffer(size_t max_size, size_t min_size, float gamma, int nstep,
 		      RewardReductionMode reward_reduction_mode, int device)
     : ReplayBuffer(max_size, min_size, device), rng_(),
-      gamma_(gamma), nstep_(nstep) {
+      gamma_(gamma), nstep_(nstep), n_agents_(1), head_(0) {
 
     // set up reward reduction mode
-    skip_incomplete_steps_ = true;
-    if (reward_reduction_mode == RewardReductionMode::MeanNoSkip) {
-      reward_reduction_mode_ = RewardReductionMode::Mean;
-      skip_incomplete_steps_ = false;
-    } else if (reward_reduction_mode == RewardReductionMode::WeightedMeanNoSkip) {
-      reward_reduction_mode_ = RewardReductionMode::WeightedMean;
-      skip_incomplete_steps_ = false;
-    } else if (reward_reduction_mode == RewardReductionMode::SumNoSkip) {
-      reward_reduction_mode_ = RewardReductionMode::Sum;
-      skip_incomplete_steps_ = false;
-    } else {
-      reward_reduction_mode_ = reward_reduction_mode;
-    }
+    std::tie(reward_reduction_mode_, skip_incomplete_steps_) = split_reward_reduction_mode(reward_reduction_mode);
   }
 
   // disable copy constructor
@@ -108,18 +116,47 @@ public:
     // add no grad guard
     torch::NoGradGuard no_grad;
 
-    // clone the tensors and move to device
-    auto sc = s.to(device_, s.dtype(), /* non_blocking = */ false, /* copy = */ true);
-    auto ac = a.to(device_, a.dtype(), /* non_blocking = */ false, /* copy = */ true);
-    auto spc = sp.to(device_, sp.dtype(), /* non_blocking = */ false, /* copy = */ true);
+    if (!buffer_.empty() && (n_agents_ != 1)) {
+      THROW_INVALID_USAGE("Replay buffer holds multi-agent data, use the multi-agent update instead.");
+    }
+    n_agents_ = 1;
 
     // add the newest element to the back
-    buffer_.push_back(std::make_tuple(sc, ac, spc, r, d));
+    append(s, a, sp, r, d);
 
     // if we reached max size already, remove the oldest element
-    if (buffer_.size() > max_size_) {
-      buffer_.pop_front();
+    evict();
+  }
+
+  // update with one transition per agent: the leading dimension of s, a, sp and r is the agent index
+  void updateMultiAgent(torch::Tensor s, torch::Tensor a, torch::Tensor sp, torch::Tensor r, bool d) {
+
+    // add no grad guard
+    torch::NoGradGuard no_grad;
+
+    int64_t n_agents = s.size(0);
+    if ((a.size(0) != n_agents) || (sp.size(0) != n_agents) || (r.numel() != n_agents)) {
+      THROW_INVALID_USAGE("Leading dimension of state, action and reward data has to match the number of agents.");
+    }
+    if (!buffer_.empty() && (static_cast<size_t>(n_agents) != n_agents_)) {
+      THROW_INVALID_USAGE("The number of agents cannot change between replay buffer updates.");
     }
+    n_agents_ = n_agents;
+
+    // move the whole batch in one copy, the entries of the individual agents are views into it
+    auto sc = s.to(device_, s.dtype(), /* non_blocking = */ false, /* copy = */ true).unbind(0);
+    auto ac = a.to(device_, a.dtype(), /* non_blocking = */ false, /* copy = */ true).unbind(0);
+    auto spc = sp.to(device_, sp.dtype(), /* non_blocking = */ false, /* copy = */ true).unbind(0);
+    auto rc = r.to(torch::kCPU, torch::kFloat32).reshape({-1}).contiguous();
+    auto r_ptr = rc.data_ptr<float>();
+
+    // agents are stored interleaved, the transitions of agent i are n_agents apart
+    for (int64_t agent = 0; agent < n_agents; ++agent) {
+      push(std::make_tuple(sc[agent], ac[agent], spc[agent], r_ptr[agent], d));
+    }
+
+    // if we reached max size already, remove the oldest time step
+    evict();
   }
 
   std::tuple<torch::Tensor, torch::Tensor, torch::Tensor, torch::Tensor, torch::Tensor>
@@ -135,13 +172,16 @@ public:
     auto r_list = std::vector<float>(batch_size);
     auto d_list = std::vector<float>(batch_size);
 
+    // draw from the valid start indices directly, no rejection of incomplete rollouts needed
+    if (valid_.empty()) {
+      THROW_INVALID_USAGE("The replay buffer does not contain any complete n-step rollout.");
+    }
     // be careful, the interval is CLOSED! We need to exclude the upper bound
-    std::uniform_int_distribution<size_t> uniform_dist(0, buffer_.size() - nstep_);
-    int sample = 0;
-    while (sample < batch_size) {
+    std::uniform_int_distribution<size_t> uniform_dist(0, valid_.size() - 1);
+    for (int sample = 0; sample < batch_size; ++sample) {
 
       // get index
-      auto index = uniform_dist(rng_);
+      auto index = static_cast<size_t>(valid_[uniform_dist(rng_)] - head_);
 
       // emit the sample at index
       float r;
@@ -156,11 +196,10 @@ public:
       }
 
       // if nstep > 1, perform rollout
-      bool skip = false;
       float deff = 1. - d_list[sample];
       for (int off = 1; off < nstep_; ++off) {
         torch::Tensor stmp, atmp;
-        std::tie(stmp, atmp, sptens_list[sample], r, d) = buffer_.at(index + off);
+        std::tie(stmp, atmp, sptens_list[sample], r, d) = buffer_.at(index + off * n_agents_);
         auto gamma_eff = static_cast<float>(std::pow(gamma_, off));
         r_list[sample] += gamma_eff * r;
         r_norm += gamma_eff;
@@ -168,9 +207,6 @@ public:
         if (d) {
 	  // 1-d = 0
           deff *= 0.;
-	  if ((off != nstep_ - 1) && skip_incomplete_steps_) {
-            skip = true;
-          }
 	} else {
 	  // 1-d = 1
 	  deff *= 1.;
@@ -178,10 +214,6 @@ public:
       }
       d_list[sample] = 1. - deff;
 
-      if (skip) {
-        continue;
-      }
-
       // reward normalization if requested:
       // mean mode is useful for infinite episodes
       // where there is no final reward
@@ -193,9 +225,6 @@ public:
         r_list[sample] /= r_norm;
         break;
       }
-
-      // increase sample index
-      sample++;
     }
 
     // stack the lists
@@ -212,7 +241,7 @@ public:
   }
 
   // check functions
-  bool isReady() const { return (buffer_.size() >= min_size_); }
+  bool isReady() const { return ((buffer_.size() >= min_size_) && !valid_.empty()); }
 
   void save(const std::string& fname) const {
     // create an ordered dict with the buffer contents:
@@ -252,6 +281,7 @@ public:
     torch::save(a_data, root_dir / "a_data.pt");
     torch::save(r_data, root_dir / "r_data.pt");
     torch::save(d_data, root_dir / "d_data.pt");
+    torch::save(torch::tensor({static_cast<int64_t>(n_agents_)}), root_dir / "n_agents.pt");
 
     return;
   }
@@ -270,8 +300,18 @@ public:
     torch::load(r_data, root_dir / "r_data.pt");
     torch::load(d_data, root_dir / "d_data.pt");
 
+    // checkpoints without agent information are single agent buffers
+    n_agents_ = 1;
+    if (std::filesystem::exists(root_dir / "n_agents.pt")) {
+      torch::Tensor n_agents;
+      torch::load(n_agents, root_dir / "n_agents.pt");
+      n_agents_ = n_agents.item<int64_t>();
+    }
+
     // iterate over loaded data and populate buffer
     buffer_.clear();
+    valid_.clear();
+    head_ = 0;
     for (size_t index = 0; index < s_data.size(); ++index) {
       auto s = s_data[index];
       auto a = a_data[index];
@@ -280,14 +320,16 @@ public:
       bool d = d_data[index].item<bool>();
 
       // update buffer
-      this->update(s, a, sp, r, d);
+      append(s, a, sp, r, d);
     }
+    evict();
   }
 
   void printInfo() const {
     std::cout << "uniform replay buffer parameters:" << std::endl;
     std::cout << "max_size = " << max_size_ << std::endl;
     std::cout << "min_size = " << min_size_ << std::endl;
+    std::cout << "n_agents = " << n_agents_ << std::endl;
   }
 
   torch::Device device() const {
@@ -295,6 +337,50 @@ public:
   }
 
 private:
+  void append(torch::Tensor s, torch::Tensor a, torch::Tensor sp, float r, bool d) {
+    // clone the tensors and move to device
+    auto sc = s.to(device_, s.dtype(), /* non_blocking = */ false, /* copy = */ true);
+    auto ac = a.to(device_, a.dtype(), /* non_blocking = */ false, /* copy = */ true);
+    auto spc = sp.to(device_, sp.dtype(), /* non_blocking = */ false, /* copy = */ true);
+
+    push(std::make_tuple(sc, ac, spc, r, d));
+  }
+
+  void push(BufferEntry entry) {
+    buffer_.push_back(std::move(entry));
+
+    // the newest entry completes the rollout window of the start nstep - 1 time steps earlier. That start is valid
+    // unless incomplete rollouts are skipped and an episode terminates inside the window before its last step.
+    int64_t window = static_cast<int64_t>((nstep_ - 1) * n_agents_);
+    int64_t start = head_ + static_cast<int64_t>(buffer_.size()) - 1 - window;
+    if (start < head_) {
+      return;
+    }
+    if (skip_incomplete_steps_) {
+      for (int off = 1; off < nstep_ - 1; ++off) {
+        if (std::get<4>(buffer_[start - head_ + off * n_agents_])) {
+          return;
+        }
+      }
+    }
+    valid_.push_back(start);
+  }
+
+  void evict() {
+    // remove whole time steps so that the agent interleaving is preserved
+    while (buffer_.size() > max_size_) {
+      for (size_t agent = 0; (agent < n_agents_) && !buffer_.empty(); ++agent) {
+        buffer_.pop_front();
+        head_++;
+      }
+    }
+
+    // starts are inserted in increasing order, the evicted ones are at the front
+    while (!valid_.empty() && (valid_.front() < head_)) {
+      valid_.pop_front();
+    }
+  }
+
   // the rbuffer contains tuples: (s, a, s', r, d)
   // std::deque<std::tuple<torch::Tensor, torch::Tensor, torch::Tensor, float, bool>> buffer_;
   std::deque<BufferEntry> buffer_;
@@ -303,6 +389,77 @@ private:
   // some parameters:
   float gamma_;
   int nstep_;
+  // number of agents sharing the buffer
+  size_t n_agents_;
+  // running index of the oldest entry and running indices of the valid rollout starts in increasing order
+  int64_t head_;
+  std::deque<int64_t> valid_;
+  RewardReductionMode reward_reduction_mode_;
+  bool skip_incomplete_steps_;
+};
+
+// Uniform replay buffer with two tiers: a hot in-memory ring on the buffer device holds the hot_size most recent
+// transitions, older ones are spilled to a cold tier in a memory mapped file in directory path, e.g. on node-local
+// NVMe. Sampling is uniform over both tiers. The rollout starts of the next batch are drawn ahead and their cold rows
+// are read asynchronously while the current batch is in use.
+class TieredReplayBuffer : public ReplayBuffer, public std::enable_shared_from_this<ReplayBuffer> {
+
+public:
+  // constructor
+  TieredReplayBuffer(size_t max_size, size_t min_size, size_t hot_size, const std::string& path, float gamma, int nstep,
+                     RewardReductionMode reward_reduction_mode, int device);
+
+  // disable copy constructor
+  TieredReplayBuffer(const TieredReplayBuffer&) = delete;
+
+  void update(torch::Tensor s, torch::Tensor a, torch::Tensor sp, float r, bool d);
+  void updateMultiAgent(torch::Tensor s, torch::Tensor a, torch::Tensor sp, torch::Tensor r, bool d);
+  std::tuple<torch::Tensor, torch::Tensor, torch::Tensor, torch::Tensor, torch::Tensor> sample(int batch_size);
+  bool isReady() const { return ((size() >= min_size_) && !valid_.empty()); }
+  void save(const std::string& fname) const;
+  void load(const std::string& fname);
+  void printInfo() const;
+  torch::Device device() const { return device_; }
+
+private:
+  size_t size() const { return static_cast<size_t>(tail_ - head_); }
+  int64_t hotBegin() const { return tail_ - static_cast<int64_t>(hot_.size()); }
+  char* coldRow(int64_t id) const;
+  // (s, a, s') of the transition with running index id, on the buffer device
+  std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> at(int64_t id) const;
+  void push(torch::Tensor s, torch::Tensor a, torch::Tensor sp, float r, bool d);
+  void evict();
+  void spill();
+  void createColdTier(const torch::Tensor& s, const torch::Tensor& a);
+  void readahead(const std::vector<int64_t>& ids) const;
+
+  std::string path_;
+  size_t hot_size_;
+  // hot tier: (s, a, s') of the running indices [tail - hot size, tail)
+  std::deque<std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>> hot_;
+  // rewards and terminal flags of all transitions [head, tail)
+  std::deque<std::pair<float, bool>> rd_;
+  int64_t head_;
+  int64_t tail_;
+  // running indices of the valid rollout starts in increasing order
+  std::deque<int64_t> valid_;
+  // rollout starts of the next batch, drawn ahead for readahead
+  std::vector<int64_t> next_ids_;
+
+  // cold tier: records (s, a, s') of the remaining transitions in a ring of cold_capacity rows
+  size_t cold_capacity_;
+  std::vector<int64_t> s_shape_, a_shape_;
+  torch::Dtype s_dtype_, a_dtype_;
+  size_t s_bytes_, a_bytes_;
+  std::unique_ptr<SpillFile> cold_;
+
+  // rng
+  std::mt19937_64 rng_;
+  // some parameters:
+  float gamma_;
+  int nstep_;
+  // number of agents sharing the buffer
+  size_t n_agents_;
   RewardReductionMode reward_reduction_mode_;
   bool skip_incomplete_steps_;
 };
@@ -88,6 +88,34 @@ void polyak_update(std::shared_ptr<ModelWrapper> target, std::shared_ptr<ModelWr
   return;
 }
 
+// Bellman target for the critic updates:
+// computes: y = r + gamma * (1 - d) * (min_i q_i(s', a') - alpha * log_prob)
+// the target critic estimates are reduced into the output of the first target critic and all further arithmetic is
+// done in place on it, so the target does not allocate any batch sized intermediates besides the model outputs
+template <typename T>
+torch::Tensor bellman_target(const std::vector<ModelPack>& q_models_target, torch::Tensor state_new_tensor,
+                             torch::Tensor action_new_tensor, torch::Tensor reward_tensor, torch::Tensor d_tensor,
+                             const T& gamma, torch::Tensor log_prob_tensor = torch::Tensor(), const T& alpha = 0) {
+
+  // add no grad guard
+  torch::NoGradGuard no_grad;
+
+  std::vector<torch::Tensor> inputs{state_new_tensor, action_new_tensor};
+  auto y_tensor = q_models_target[0].model->forward(inputs)[0];
+  for (size_t i = 1; i < q_models_target.size(); ++i) {
+    torch::minimum_out(y_tensor, y_tensor, q_models_target[i].model->forward(inputs)[0]);
+  }
+  if (log_prob_tensor.defined()) {
+    y_tensor.sub_(log_prob_tensor, alpha);
+  }
+  // gamma * (1 - d) * q = gamma * q - gamma * q * d
+  y_tensor.mul_(gamma);
+  y_tensor.addcmul_(y_tensor, d_tensor, -1);
+  y_tensor.add_(reward_tensor);
+
+  return y_tensor;
+}
+
 // Rescale the action from [a_low, a_high] to [-1, 1]
 template <typename T> torch::Tensor scale_action(torch::Tensor unscaled_action, const T& a_low, const T& a_high) {
   auto scaled_action = static_cast<T>(2.0) * ((unscaled_action - a_low) / (a_high - a_low)) - static_cast<T>(1.0);
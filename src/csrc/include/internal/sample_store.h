@@ -0,0 +1,118 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2023 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include <memory>
+#include <random>
+#include <string>
+#include <tuple>
+
+#include <torch/torch.h>
+#include <yaml-cpp/yaml.h>
+
+#include "internal/spill_file.h"
+#include "internal/sum_tree.h"
+
+namespace torchfort {
+
+enum SampleStorePolicy { Ring = 0, Reservoir = 1 };
+
+// Preallocated per-model store of training samples. Samples are appended in bulk and
+// drawn as shuffled minibatches via a single gather. If spill_dir is set, samples are kept in a
+// memory-mapped file in that directory instead of device memory.
+class SampleStore {
+public:
+  SampleStore(size_t capacity, size_t batch_size, SampleStorePolicy policy, torch::Device device,
+              const std::string& spill_dir = "");
+
+  // disable copy constructor
+  SampleStore(const SampleStore&) = delete;
+
+  // append samples, the leading dimension of inputs and labels is the sample dimension
+  void add(torch::Tensor inputs, torch::Tensor labels);
+
+  // draw a minibatch of n_samples samples (batch_size if 0), samples are not repeated until all stored samples
+  // have been drawn
+  std::tuple<torch::Tensor, torch::Tensor> sample(size_t n_samples = 0);
+
+  // sample proportionally to (loss + eps)^alpha of the last training iteration on each sample, importance
+  // weights ((size * P(i))^-beta, normalized to a maximum of one) correct for the non-uniform sampling
+  void enablePriorities(double alpha, double beta, double eps);
+  bool prioritized() const { return priorities_ != nullptr; }
+
+  // draw a minibatch by priority, returns inputs, labels, importance weights and store indices
+  std::tuple<torch::Tensor, torch::Tensor, torch::Tensor, torch::Tensor> samplePrioritized(size_t n_samples = 0);
+
+  // record the per-sample losses of a minibatch drawn with samplePrioritized
+  void updatePriorities(const torch::Tensor& indices, const torch::Tensor& sample_losses);
+
+  size_t size() const { return size_; }
+  size_t capacity() const { return capacity_; }
+  size_t batchSize() const { return batch_size_; }
+
+private:
+  torch::Device storageDevice() const { return spill_dir_.empty() ? device_ : torch::Device(torch::kCPU); }
+  void allocate(const torch::Tensor& inputs, const torch::Tensor& labels);
+  torch::Tensor insertIndices(int64_t n, torch::Tensor& src_indices);
+  torch::Tensor drawPrioritized(int64_t batch_size);
+
+  size_t capacity_;
+  size_t batch_size_;
+  SampleStorePolicy policy_;
+  torch::Device device_;
+  std::string spill_dir_;
+
+  // declared before the sample tensors, which are views of the mapped file if spilling
+  std::unique_ptr<SpillFile> spill_;
+
+  size_t size_ = 0;
+  size_t head_ = 0;
+  int64_t n_seen_ = 0;
+  torch::Tensor inputs_, labels_;
+
+  // shuffled order of stored samples and current position in it
+  torch::Tensor order_;
+  int64_t order_pos_ = 0;
+
+  // priorities of stored samples, new samples enter with the maximum priority seen so far
+  std::unique_ptr<SumTree> priorities_;
+  double alpha_ = 0.0;
+  double beta_ = 0.0;
+  double eps_ = 0.0;
+  double max_priority_ = 1.0;
+  // prioritized minibatch drawn ahead for readahead of spilled records
+  torch::Tensor next_indices_;
+
+  std::mt19937_64 rng_;
+};
+
+std::shared_ptr<SampleStore> get_sample_store(const YAML::Node& sample_store_node, torch::Device device);
+
+} // namespace torchfort
@@ -29,6 +29,8 @@
  */
 
 #pragma once
+#include <algorithm>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 
@@ -41,6 +43,7 @@
 #include <internal/defines.h>
 #include <internal/logging.h>
 #include <internal/nvtx.h>
+#include <internal/pipeline.h>
 #include <internal/utils.h>
 
 // Forward declaration
@@ -50,6 +53,7 @@ namespace torchfort {
 
 // Declaration of external global variables
 extern std::unordered_map<std::string, ModelPack> models;
+extern std::unordered_map<std::string, std::shared_ptr<Pipeline>> pipelines;
 
 template <MemoryLayout L, typename T>
 void inference(const char* name, T* input, size_t input_dim, int64_t* input_shape, T* output, size_t output_dim,
@@ -58,6 +62,12 @@ void inference(const char* name, T* input, size_t input_dim, int64_t* input_shap
 
   torch::NoGradGuard no_grad;
 
+  // with asynchronous training, inference runs in between training iterations
+  std::unique_lock<std::mutex> step_lock;
+  if (models[name].async_trainer) {
+    step_lock = models[name].async_trainer->lockStep();
+  }
+
   auto model = models[name].model.get();
 
   c10::cuda::OptionalCUDAStreamGuard guard;
@@ -69,26 +79,74 @@ void inference(const char* name, T* input, size_t input_dim, int64_t* input_shap
   auto input_tensor_in = get_tensor<L>(input, input_dim, input_shape);
   auto output_tensor_in = get_tensor<L>(output, output_dim, output_shape);
   auto input_tensor = input_tensor_in.to(model->device());
+  auto normalizer = models[name].normalizer.get();
+  if (normalizer) {
+    input_tensor = normalizer->normalizeInputs(input_tensor);
+  }
+
+  // stateful models continue from the hidden state of the active stream
+  std::vector<torch::Tensor> inputs{input_tensor};
+  auto recurrent_state = models[name].recurrent_state.get();
+  if (recurrent_state) {
+    const auto& hidden = recurrent_state->streams[recurrent_state->active_stream];
+    inputs.insert(inputs.end(), hidden.begin(), hidden.end());
+  }
 
   model->eval();
-  auto results = model->forward(std::vector<torch::Tensor>{input_tensor});
+  auto results = model->forward(inputs);
+
+  if (recurrent_state) {
+    recurrent_state->streams[recurrent_state->active_stream].assign(results.begin() + 1, results.end());
+  }
+
+  // reduce over ensemble members stacked along the leading dimension
+  auto output = results[0];
+  if (model->ensemble_size() > 1) {
+    switch (models[name].state->ensemble_output) {
+    case TORCHFORT_ENSEMBLE_MEAN:
+      output = output.mean(0);
+      break;
+    case TORCHFORT_ENSEMBLE_VARIANCE:
+      output = output.var(0, /*unbiased=*/false);
+      break;
+    case TORCHFORT_ENSEMBLE_ALL:
+      break;
+    }
+  }
 
-  output_tensor_in.copy_(results[0].reshape(output_tensor_in.sizes()));
+  if (normalizer) {
+    bool variance = model->ensemble_size() > 1 && models[name].state->ensemble_output == TORCHFORT_ENSEMBLE_VARIANCE;
+    normalizer->denormalizeOutput(output, output_tensor_in, variance);
+  } else {
+    output_tensor_in.copy_(output.reshape(output_tensor_in.sizes()));
+  }
+  if (step_lock.owns_lock() && model->device().is_cuda()) {
+    // the next training iteration updates the parameters in place
+    c10::cuda::getCurrentCUDAStream(model->device().index()).synchronize();
+  }
   models[name].state->step_inference++;
   torchfort::nvtx::rangePop();
 }
 
 template <MemoryLayout L, typename T>
-void train(const char* name, T* input, size_t input_dim, int64_t* input_shape, T* label, size_t label_dim,
-           int64_t* label_shape, T* loss_val, cudaStream_t ext_stream = 0) {
-  torchfort::nvtx::rangePush("torchfort_train");
+void inference_mc(const char* name, T* input, size_t input_dim, int64_t* input_shape, int64_t n_samples, T* mean,
+                  size_t mean_dim, int64_t* mean_shape, T* var, size_t var_dim, int64_t* var_shape,
+                  cudaStream_t ext_stream = 0) {
+  torchfort::nvtx::rangePush("torchfort_inference_mc");
 
-  if (!models[name].optimizer) {
-    THROW_INVALID_USAGE("Training requires an optimizer, but optimizer block was missing in configuration file.");
+  if (n_samples < 1) {
+    THROW_INVALID_USAGE("n_samples must be a positive integer.");
+  }
+  if (models[name].recurrent_state) {
+    THROW_NOT_SUPPORTED("MC-dropout inference is not supported for stateful models.");
   }
 
-  if (!models[name].loss) {
-    THROW_INVALID_USAGE("Training requires a loss function, but loss block was missing in configuration file.");
+  torch::NoGradGuard no_grad;
+
+  // with asynchronous training, inference runs in between training iterations
+  std::unique_lock<std::mutex> step_lock;
+  if (models[name].async_trainer) {
+    step_lock = models[name].async_trainer->lockStep();
   }
 
   auto model = models[name].model.get();
@@ -100,61 +158,380 @@ void train(const char* name, T* input, size_t input_dim, int64_t* input_shape, T
   }
 
   auto input_tensor_in = get_tensor<L>(input, input_dim, input_shape);
-  auto label_tensor_in = get_tensor<L>(label, label_dim, label_shape);
+  auto mean_tensor_in = get_tensor<L>(mean, mean_dim, mean_shape);
+  auto var_tensor_in = get_tensor<L>(var, var_dim, var_shape);
   auto input_tensor = input_tensor_in.to(model->device());
-  auto label_tensor = label_tensor_in.to(model->device());
+  auto normalizer = models[name].normalizer.get();
+  if (normalizer) {
+    input_tensor = normalizer->normalizeInputs(input_tensor);
+  }
+
+  // replicate the batch so that all stochastic passes run as a single forward with independent dropout masks
+  auto batch_size = input_tensor.size(0);
+  std::vector<int64_t> expand_shape{n_samples};
+  expand_shape.insert(expand_shape.end(), input_tensor.sizes().begin(), input_tensor.sizes().end());
+  auto replicated_shape = input_tensor.sizes().vec();
+  replicated_shape[0] *= n_samples;
+  auto replicated = input_tensor.unsqueeze(0).expand(expand_shape).reshape(replicated_shape);
+
+  model->eval_mc_dropout();
+  auto output = model->forward(std::vector<torch::Tensor>{replicated})[0];
+  model->eval();
+
+  // ensemble members contribute additional samples, view outputs as [samples, batch, ...]
+  std::vector<int64_t> sample_shape{-1, batch_size};
+  int64_t leading_dims = (model->ensemble_size() > 1) ? 2 : 1;
+  sample_shape.insert(sample_shape.end(), output.sizes().begin() + leading_dims, output.sizes().end());
+  auto [output_var, output_mean] = torch::var_mean(output.reshape(sample_shape), 0, /*unbiased=*/false);
+
+  if (normalizer) {
+    normalizer->denormalizeOutput(output_mean, mean_tensor_in, false);
+    normalizer->denormalizeOutput(output_var, var_tensor_in, true);
+  } else {
+    mean_tensor_in.copy_(output_mean.reshape(mean_tensor_in.sizes()));
+    var_tensor_in.copy_(output_var.reshape(var_tensor_in.sizes()));
+  }
+  if (step_lock.owns_lock() && model->device().is_cuda()) {
+    // the next training iteration updates the parameters in place
+    c10::cuda::getCurrentCUDAStream(model->device().index()).synchronize();
+  }
+  models[name].state->step_inference++;
+  torchfort::nvtx::rangePop();
+}
+
+template <MemoryLayout L, typename T>
+void inference_pipeline(const char* name, T* input, size_t input_dim, int64_t* input_shape, T* output,
+                        size_t output_dim, int64_t* output_shape, cudaStream_t ext_stream = 0) {
+  torchfort::nvtx::rangePush("torchfort_inference_pipeline");
+
+  if (pipelines.count(name) == 0) {
+    THROW_INVALID_USAGE("Unknown pipeline " + std::string(name) + ".");
+  }
+  auto pipeline = pipelines[name];
+
+  torch::NoGradGuard no_grad;
+
+  // with asynchronous training, inference runs in between training iterations. Locks are taken in a fixed order.
+  auto model_names = pipeline->models();
+  auto lock_order = model_names;
+  std::sort(lock_order.begin(), lock_order.end());
+  std::vector<std::unique_lock<std::mutex>> step_locks;
+  for (const auto& model_name : lock_order) {
+    if (models[model_name].async_trainer) {
+      step_locks.push_back(models[model_name].async_trainer->lockStep());
+    }
+  }
+
+  // the pipeline input and stream belong to the device of the first stage
+  auto device = models[model_names[0]].model->device();
+
+  c10::cuda::OptionalCUDAStreamGuard guard;
+  if (device.is_cuda()) {
+    auto stream = c10::cuda::getStreamFromExternal(ext_stream, device.index());
+    guard.reset_stream(stream);
+  }
+
+  auto input_tensor_in = get_tensor<L>(input, input_dim, input_shape);
+  auto output_tensor_in = get_tensor<L>(output, output_dim, output_shape);
+  pipeline->run(input_tensor_in.to(device), output_tensor_in);
+
+  if (!step_locks.empty()) {
+    // the next training iterations update the parameters in place
+    for (const auto& model_name : model_names) {
+      auto model_device = models[model_name].model->device();
+      if (model_device.is_cuda()) {
+        c10::cuda::getCurrentCUDAStream(model_device.index()).synchronize();
+      }
+    }
+  }
+  for (const auto& model_name : model_names) {
+    models[model_name].state->step_inference++;
+  }
+  torchfort::nvtx::rangePop();
+}
+
+inline void check_training_setup(const char* name) {
+  if (!models[name].optimizer) {
+    THROW_INVALID_USAGE("Training requires an optimizer, but optimizer block was missing in configuration file.");
+  }
+
+  if (!models[name].loss) {
+    THROW_INVALID_USAGE("Training requires a loss function, but loss block was missing in configuration file.");
+  }
+}
+
+// Drain the asynchronous training queue (if any) before accessing the model from the calling thread
+inline void wait_async_training(const char* name) {
+  if (models[name].async_trainer) {
+    models[name].async_trainer->wait();
+  }
+}
+
+// Run a single training iteration on input and label tensors residing on the model device. If sample_weights
+// is defined, the loss is weighted per sample and the unweighted per-sample losses are returned in sample_losses.
+// With a batch growth schedule and accumulate_gradients set, gradients of batch_factor consecutive iterations
+// are accumulated into a single optimizer step. The model pack is passed explicitly, so that the asynchronous
+// training thread does not access the global model registry.
+template <typename T>
+void train_step(const char* name, ModelPack& model_pack, torch::Tensor input_tensor, torch::Tensor label_tensor,
+                T* loss_val, const torch::Tensor& sample_weights = torch::Tensor(),
+                torch::Tensor* sample_losses = nullptr, bool accumulate_gradients = true) {
+  auto model = model_pack.model.get();
+  auto state = model_pack.state.get();
+
+  // the window length is fixed when it starts, the schedule may only advance with an optimizer step
+  if (state->accumulation_step == 0) {
+    state->accumulation_steps =
+        (accumulate_gradients && model_pack.lr_scheduler) ? model_pack.lr_scheduler->batch_factor() : 1;
+  }
+  bool first_step = state->accumulation_step == 0;
+  bool last_step = state->accumulation_step + 1 >= state->accumulation_steps;
+
+  // accumulate running statistics of the raw batch and train in normalized space
+  auto normalizer = model_pack.normalizer.get();
+  if (normalizer) {
+    normalizer->update(input_tensor, label_tensor, model_pack.comm);
+    input_tensor = normalizer->normalizeInputs(input_tensor);
+    label_tensor = normalizer->normalizeLabels(label_tensor);
+  }
 
   model->train();
-  auto opt = models[name].optimizer.get();
+  auto opt = model_pack.optimizer.get();
 
   // fwd pass
   auto results = model->forward(std::vector<torch::Tensor>{input_tensor});
-  auto losses =
-      models[name].loss->forward(std::vector<torch::Tensor>{results[0]}, std::vector<torch::Tensor>{label_tensor});
+  torch::Tensor sample_loss_sum;
+  auto compute_losses = [&](const torch::Tensor& output) {
+    std::vector<torch::Tensor> outputs{output}, labels{label_tensor};
+    if (!sample_weights.defined()) {
+      return model_pack.loss->forward(outputs, labels);
+    }
+    torch::Tensor member_sample_losses;
+    auto member_losses = model_pack.loss->forward_weighted(outputs, labels, sample_weights, member_sample_losses);
+    sample_loss_sum = sample_loss_sum.defined() ? sample_loss_sum + member_sample_losses : member_sample_losses;
+    return member_losses;
+  };
+
+  std::vector<torch::Tensor> losses;
+  auto ensemble_size = model->ensemble_size();
+  if (ensemble_size > 1) {
+    // ensemble members are trained independently on the same data: the loss is the sum of the member losses,
+    // so that every member receives the gradients of a standalone model
+    auto loss = compute_losses(results[0][0])[0];
+    for (int64_t i = 1; i < ensemble_size; ++i) {
+      loss = loss + compute_losses(results[0][i])[0];
+    }
+    losses.push_back(loss);
+  } else {
+    losses = compute_losses(results[0]);
+  }
+
+  if (sample_losses) {
+    *sample_losses = sample_loss_sum / ensemble_size;
+  }
 
-  // extract loss
-  *loss_val = losses[0].template item<T>();
+  // extract loss (averaged over ensemble members)
+  *loss_val = losses[0].template item<T>() / ensemble_size;
 
-  // bwd pass
-  opt->zero_grad();
+  // bwd pass, accumulated gradients are averaged over the window
+  if (first_step) {
+    opt->zero_grad();
+  }
   for (const auto& l : losses) {
-    l.backward();
+    if (state->accumulation_steps > 1) {
+      (l / static_cast<double>(state->accumulation_steps)).backward();
+    } else {
+      l.backward();
+    }
   }
 
   // allreduce (average) gradients (if running distributed)
-  if (models[name].comm) {
-    std::vector<torch::Tensor> grads;
-    grads.reserve(model->parameters().size());
-    for (const auto& p : model->parameters()) {
-      grads.push_back(p.grad());
+  if (model_pack.comm) {
+    if (last_step) {
+      // frozen parameters have no gradients and are not communicated
+      auto parameters = model->trainable_parameters();
+      std::vector<torch::Tensor> grads;
+      grads.reserve(parameters.size());
+      for (const auto& p : parameters) {
+        grads.push_back(p.grad());
+      }
+      model_pack.comm->allreduce(grads, true);
     }
-    models[name].comm->allreduce(grads, true);
 
     // average returned loss value
-    models[name].comm->allreduce(*loss_val, true);
+    model_pack.comm->allreduce(*loss_val, true);
   }
 
-  opt->step();
-  if (models[name].lr_scheduler) {
-    models[name].lr_scheduler->step();
+  if (last_step) {
+    opt->step();
+    if (model_pack.lr_scheduler) {
+      model_pack.lr_scheduler->step();
+    }
+    state->accumulation_step = 0;
+  } else {
+    state->accumulation_step++;
   }
 
-  auto state = models[name].state.get();
   state->step_train++;
   if (state->report_frequency > 0 && state->step_train % state->report_frequency == 0) {
     std::stringstream os;
     os << "model: " << name << ", ";
     os << "step_train: " << state->step_train << ", ";
     os << "loss: " << *loss_val << ", ";
-    auto lrs = torchfort_model_get_current_lrs(name);
-    os << "lr: " << lrs[0];
-    if (!models[name].comm || (models[name].comm && models[name].comm->rank == 0)) {
+    auto lr = opt->param_groups()[0].options().get_lr();
+    os << "lr: " << lr;
+    if (!model_pack.comm || (model_pack.comm && model_pack.comm->rank == 0)) {
       torchfort::logging::print(os.str(), torchfort::logging::info);
-      if (state->enable_wandb_hook)
-        torchfort::wandb_log(name, "train_loss", state->step_train, *loss_val);
-      torchfort::wandb_log(name, "train_lr", state->step_train, lrs[0]);
+      torchfort::wandb_log(model_pack.state, model_pack.comm, name, "train_loss", state->step_train, *loss_val);
+      torchfort::wandb_log(model_pack.state, model_pack.comm, name, "train_lr", state->step_train, lr);
+    }
+  }
+}
+
+template <typename T>
+void train_step(const char* name, torch::Tensor input_tensor, torch::Tensor label_tensor, T* loss_val,
+                const torch::Tensor& sample_weights = torch::Tensor(), torch::Tensor* sample_losses = nullptr,
+                bool accumulate_gradients = true) {
+  train_step(name, models[name], input_tensor, label_tensor, loss_val, sample_weights, sample_losses,
+             accumulate_gradients);
+}
+
+template <MemoryLayout L, typename T>
+void train(const char* name, T* input, size_t input_dim, int64_t* input_shape, T* label, size_t label_dim,
+           int64_t* label_shape, T* loss_val, cudaStream_t ext_stream = 0) {
+  torchfort::nvtx::rangePush("torchfort_train");
+
+  check_training_setup(name);
+  wait_async_training(name);
+
+  auto model = models[name].model.get();
+
+  c10::cuda::OptionalCUDAStreamGuard guard;
+  if (model->device().is_cuda()) {
+    auto stream = c10::cuda::getStreamFromExternal(ext_stream, model->device().index());
+    guard.reset_stream(stream);
+  }
+
+  auto input_tensor_in = get_tensor<L>(input, input_dim, input_shape);
+  auto label_tensor_in = get_tensor<L>(label, label_dim, label_shape);
+  auto input_tensor = input_tensor_in.to(model->device());
+  auto label_tensor = label_tensor_in.to(model->device());
+
+  train_step(name, input_tensor, label_tensor, loss_val);
+
+  torchfort::nvtx::rangePop();
+}
+
+template <MemoryLayout L, typename T>
+void train_async(const char* name, T* input, size_t input_dim, int64_t* input_shape, T* label, size_t label_dim,
+                 int64_t* label_shape, cudaStream_t ext_stream = 0) {
+  torchfort::nvtx::rangePush("torchfort_train_async");
+
+  check_training_setup(name);
+
+  if (!models[name].async_trainer) {
+    THROW_INVALID_USAGE(
+        "Asynchronous training requires a training queue, but async_training block was missing in configuration file.");
+  }
+
+  auto model = models[name].model.get();
+
+  c10::cuda::OptionalCUDAStreamGuard guard;
+  if (model->device().is_cuda()) {
+    auto stream = c10::cuda::getStreamFromExternal(ext_stream, model->device().index());
+    guard.reset_stream(stream);
+  }
+
+  auto input_tensor = get_tensor<L>(input, input_dim, input_shape);
+  auto label_tensor = get_tensor<L>(label, label_dim, label_shape);
+  models[name].async_trainer->push(input_tensor, label_tensor);
+
+  torchfort::nvtx::rangePop();
+}
+
+template <MemoryLayout L, typename T>
+void add_samples(const char* name, T* input, size_t input_dim, int64_t* input_shape, T* label, size_t label_dim,
+                 int64_t* label_shape, cudaStream_t ext_stream = 0) {
+  torchfort::nvtx::rangePush("torchfort_add_samples");
+
+  if (!models[name].sample_store) {
+    THROW_INVALID_USAGE(
+        "Adding samples requires a sample store, but sample_store block was missing in configuration file.");
+  }
+
+  auto model = models[name].model.get();
+
+  c10::cuda::OptionalCUDAStreamGuard guard;
+  if (model->device().is_cuda()) {
+    auto stream = c10::cuda::getStreamFromExternal(ext_stream, model->device().index());
+    guard.reset_stream(stream);
+  }
+
+  // the leading (row-major) dimension is the sample dimension
+  auto input_tensor = get_tensor<L>(input, input_dim, input_shape);
+  auto label_tensor = get_tensor<L>(label, label_dim, label_shape);
+  models[name].sample_store->add(input_tensor, label_tensor);
+
+  torchfort::nvtx::rangePop();
+}
+
+template <typename T>
+void train_from_store(const char* name, int64_t n_steps, T* loss_val, cudaStream_t ext_stream = 0) {
+  torchfort::nvtx::rangePush("torchfort_train_from_store");
+
+  check_training_setup(name);
+  wait_async_training(name);
+
+  if (!models[name].sample_store) {
+    THROW_INVALID_USAGE(
+        "Training from store requires a sample store, but sample_store block was missing in configuration file.");
+  }
+
+  auto model = models[name].model.get();
+
+  c10::cuda::OptionalCUDAStreamGuard guard;
+  if (model->device().is_cuda()) {
+    auto stream = c10::cuda::getStreamFromExternal(ext_stream, model->device().index());
+    guard.reset_stream(stream);
+  }
+
+  // report the mean loss over all steps
+  T loss_sum = 0;
+  for (int64_t i = 0; i < n_steps; ++i) {
+    auto sample_store = models[name].sample_store.get();
+
+    // a batch growth schedule draws a larger minibatch once the store holds enough samples, and accumulates
+    // gradients of several minibatches before that
+    size_t n_samples = sample_store->batchSize();
+    bool accumulate_gradients = true;
+    if (models[name].lr_scheduler && models[name].state->accumulation_step == 0) {
+      auto factor = models[name].lr_scheduler->batch_factor();
+      if (factor > 1) {
+        // stores fill at different rates, all ranks switch once every store holds enough samples
+        int large_batch = (sample_store->size() >= factor * n_samples) ? 1 : 0;
+        if (models[name].comm) {
+          CHECK_MPI(MPI_Allreduce(MPI_IN_PLACE, &large_batch, 1, MPI_INT, MPI_MIN, models[name].comm->mpi_comm));
+        }
+        if (large_batch) {
+          n_samples *= factor;
+          accumulate_gradients = false;
+        }
+      }
+    }
+
+    T step_loss;
+    if (sample_store->prioritized()) {
+      auto [input_tensor, label_tensor, weights, indices] = sample_store->samplePrioritized(n_samples);
+      torch::Tensor sample_losses;
+      train_step(name, input_tensor, label_tensor, &step_loss, weights, &sample_losses, accumulate_gradients);
+      sample_store->updatePriorities(indices, sample_losses);
+    } else {
+      auto [input_tensor, label_tensor] = sample_store->sample(n_samples);
+      train_step(name, input_tensor, label_tensor, &step_loss, torch::Tensor(), nullptr, accumulate_gradients);
     }
+    loss_sum += step_loss;
   }
+  *loss_val = n_steps > 0 ? loss_sum / n_steps : T(0);
 
   torchfort::nvtx::rangePop();
 }
@@ -79,6 +79,69 @@ torchfort_result_t torchfort_create_model(const char* name, const char* config_f
 torchfort_result_t torchfort_create_distributed_model(const char* name, const char* config_fname, MPI_Comm mpi_comm,
                                                       int device);
 
+// Model setup functions
+/**
+ * @brief Registers the graph connectivity used by a model of type GNN. The connectivity is cached in the model
+ * and reused for all subsequent training and inference calls. For ensembles, all members share the connectivity.
+ *
+ * @param[in] name The name of model instance to use, as defined during model creation.
+ * @param[in] n_nodes Number of nodes in the graph.
+ * @param[in] n_edges Number of directed edges in the graph.
+ * @param[in] row_offsets A pointer to an array of length \p n_nodes + 1 holding the CSR row offsets. Row i lists
+ * the nodes sending messages to node i.
+ * @param[in] col_indices A pointer to an array of length \p n_edges holding the CSR column indices.
+ *
+ * @return \p TORCHFORT_RESULT_SUCCESS on success or error code on failure.
+ */
+torchfort_result_t torchfort_set_graph(const char* name, int64_t n_nodes, int64_t n_edges, int64_t* row_offsets,
+                                       int64_t* col_indices);
+
+torchfort_result_t torchfort_set_graph_F(const char* name, int64_t n_nodes, int64_t n_edges, int64_t* row_offsets,
+                                         int64_t* col_indices);
+
+/**
+ * @brief Selects the state stream used by subsequent inference calls of a stateful model. Each stream keeps its own
+ * hidden state between calls, e.g., one stream per cell block.
+ *
+ * @param[in] name The name of model instance to use, as defined during model creation.
+ * @param[in] stream_id Identifier of the state stream to use. Streams are created on first use with a zero state.
+ *
+ * @return \p TORCHFORT_RESULT_SUCCESS on success or error code on failure.
+ */
+torchfort_result_t torchfort_set_state_stream(const char* name, int64_t stream_id);
+
+/**
+ * @brief Resets the hidden state of a state stream of a stateful model.
+ *
+ * @param[in] name The name of model instance to use, as defined during model creation.
+ * @param[in] stream_id Identifier of the state stream to reset.
+ *
+ * @return \p TORCHFORT_RESULT_SUCCESS on success or error code on failure.
+ */
+torchfort_result_t torchfort_reset_state(const char* name, int64_t stream_id);
+
+/**
+ * @brief Resets the hidden state of all state streams of a stateful model.
+ *
+ * @param[in] name The name of model instance to use, as defined during model creation.
+ *
+ * @return \p TORCHFORT_RESULT_SUCCESS on success or error code on failure.
+ */
+torchfort_result_t torchfort_reset_all_states(const char* name);
+
+/**
+ * @brief Selects the output returned by inference calls of a model ensemble, i.e., a model configured with
+ * \p ensemble_size > 1.
+ *
+ * @param[in] name The name of model instance to use, as defined during model creation.
+ * @param[in] output Either the mean (default) or variance over ensemble members, or the outputs of all members. For
+ * \p TORCHFORT_ENSEMBLE_ALL, the output buffer of inference calls requires an additional slowest varying dimension of
+ * size \p ensemble_size.
+ *
+ * @return \p TORCHFORT_RESULT_SUCCESS on success or error code on failure.
+ */
+torchfort_result_t torchfort_set_ensemble_output(const char* name, torchfort_ensemble_output_t output);
+
 // Training and inference functions
 /**
  * @brief Runs a training iteration of a model instance using provided input and label data.
@@ -106,6 +169,107 @@ torchfort_result_t torchfort_train_F(const char* name, void* input, size_t input
                                      size_t label_dim, int64_t* label_shape, void* loss_val, torchfort_datatype_t dtype,
                                      cudaStream_t stream);
 
+/**
+ * @brief Trains a model instance on a dataset of memory-mapped .npy or raw binary shards described in a YAML
+ * configuration file. For distributed models, shards are split across ranks.
+ *
+ * @param[in] name The name of model instance to use, as defined during model creation.
+ * @param[in] dataset_config_fname Filesystem path to the dataset configuration file.
+ *
+ * @return \p TORCHFORT_RESULT_SUCCESS on success or error code on failure.
+ */
+torchfort_result_t torchfort_train_dataset(const char* name, const char* dataset_config_fname);
+
+/**
+ * @brief Submits a training iteration of a model instance for asynchronous execution. Input and label data are copied
+ * into a bounded staging queue consumed by a dedicated training thread, and the call returns without waiting for the
+ * training iteration. Requires an \p async_training block in the configuration file.
+ *
+ * @param[in] name The name of model instance to use, as defined during model creation.
+ * @param[in] input A pointer to a memory buffer containing current input data.
+ * @param[in] input_dim Rank of the input data.
+ * @param[in] input_shape A pointer to an array specifying the shape of the input data. Length should be equal to the
+ * rank of the input data.
+ * @param[in] label A pointer to a memory buffer containing current label data.
+ * @param[in] label_dim Rank of the label data.
+ * @param[in] label_shape A pointer to an array specifying the shape of the label data. Length should be equal to the
+ * rank of the label data.
+ * @param[out] dtype The TorchFort datatype to use for this operation.
+ * @param[out] stream CUDA stream to enqueue the data staging. This argument is ignored if the model is on the CPU.
+ *
+ * @return \p TORCHFORT_RESULT_SUCCESS on success or error code on failure.
+ */
+torchfort_result_t torchfort_train_async(const char* name, void* input, size_t input_dim, int64_t* input_shape,
+                                         void* label, size_t label_dim, int64_t* label_shape,
+                                         torchfort_datatype_t dtype, cudaStream_t stream);
+
+torchfort_result_t torchfort_train_async_F(const char* name, void* input, size_t input_dim, int64_t* input_shape,
+                                           void* label, size_t label_dim, int64_t* label_shape,
+                                           torchfort_datatype_t dtype, cudaStream_t stream);
+
+/**
+ * @brief Blocks until all training iterations submitted with \p torchfort_train_async have completed. Errors raised
+ * during asynchronous training are reported by this call.
+ *
+ * @param[in] name The name of model instance to use, as defined during model creation.
+ *
+ * @return \p TORCHFORT_RESULT_SUCCESS on success or error code on failure.
+ */
+torchfort_result_t torchfort_train_wait(const char* name);
+
+/**
+ * @brief Retrieves the loss value of the most recently completed asynchronous training iteration without blocking.
+ *
+ * @param[in] name The name of model instance to use, as defined during model creation.
+ * @param[out] loss_val A pointer to a memory location to write the loss value.
+ * @param[out] dtype The TorchFort datatype of \p loss_val.
+ *
+ * @return \p TORCHFORT_RESULT_SUCCESS on success or error code on failure.
+ */
+torchfort_result_t torchfort_get_loss(const char* name, void* loss_val, torchfort_datatype_t dtype);
+
+/**
+ * @brief Appends samples to the sample store of a model instance. The slowest varying dimension of the input and label
+ * data is the sample dimension. Requires a \p sample_store block in the configuration file.
+ *
+ * @param[in] name The name of model instance to use, as defined during model creation.
+ * @param[in] input A pointer to a memory buffer containing input samples.
+ * @param[in] input_dim Rank of the input data.
+ * @param[in] input_shape A pointer to an array specifying the shape of the input data. Length should be equal to the
+ * rank of the input data.
+ * @param[in] label A pointer to a memory buffer containing label samples.
+ * @param[in] label_dim Rank of the label data.
+ * @param[in] label_shape A pointer to an array specifying the shape of the label data. Length should be equal to the
+ * rank of the label data.
+ * @param[out] dtype The TorchFort datatype to use for this operation.
+ * @param[out] stream CUDA stream to enqueue the operation. This argument is ignored if the model is on the CPU.
+ *
+ * @return \p TORCHFORT_RESULT_SUCCESS on success or error code on failure.
+ */
+torchfort_result_t torchfort_add_samples(const char* name, void* input, size_t input_dim, int64_t* input_shape,
+                                         void* label, size_t label_dim, int64_t* label_shape,
+                                         torchfort_datatype_t dtype, cudaStream_t stream);
+
+torchfort_result_t torchfort_add_samples_F(const char* name, void* input, size_t input_dim, int64_t* input_shape,
+                                           void* label, size_t label_dim, int64_t* label_shape,
+                                           torchfort_datatype_t dtype, cudaStream_t stream);
+
+/**
+ * @brief Runs training iterations of a model instance on shuffled minibatches drawn from its sample store.
+ * @details For distributed models, this is a collective operation which has to be called with the same \p n_steps on
+ * all ranks.
+ *
+ * @param[in] name The name of model instance to use, as defined during model creation.
+ * @param[in] n_steps Number of training iterations to run.
+ * @param[out] loss_val A pointer to a memory location to write the loss value averaged over the training iterations.
+ * @param[out] dtype The TorchFort datatype of \p loss_val.
+ * @param[out] stream CUDA stream to enqueue the operation. This argument is ignored if the model is on the CPU.
+ *
+ * @return \p TORCHFORT_RESULT_SUCCESS on success or error code on failure.
+ */
+torchfort_result_t torchfort_train_from_store(const char* name, int64_t n_steps, void* loss_val,
+                                              torchfort_datatype_t dtype, cudaStream_t stream);
+
 /**
  * @brief Runs inference on a model using provided input data.
  *
@@ -131,6 +295,78 @@ torchfort_result_t torchfort_inference_F(const char* name, void* input, size_t i
                                          void* output, size_t output_dim, int64_t* output_shape,
                                          torchfort_datatype_t dtype, cudaStream_t stream);
 
+/**
+ * @brief Runs Monte Carlo dropout inference on a model, returning the mean and variance of the output over
+ * \p n_samples stochastic forward passes. The passes are evaluated as a single batched forward with dropout active.
+ *
+ * @param[in] name The name of model instance to use, as defined during model creation.
+ * @param[in] input A pointer to a memory buffer containing input data.
+ * @param[in] input_dim Rank of the input data.
+ * @param[in] input_shape A pointer to an array specifying the shape of the input data. Length should be equal to the
+ * rank of the input data.
+ * @param[in] n_samples Number of stochastic forward passes.
+ * @param[in,out] mean A pointer to a memory buffer to write the output mean.
+ * @param[in] mean_dim Rank of the output mean.
+ * @param[in] mean_shape A pointer to an array specifying the shape of the output mean. Length should be equal to the
+ * rank of the output mean.
+ * @param[in,out] var A pointer to a memory buffer to write the output variance.
+ * @param[in] var_dim Rank of the output variance.
+ * @param[in] var_shape A pointer to an array specifying the shape of the output variance. Length should be equal to
+ * the rank of the output variance.
+ * @param[out] dtype The TorchFort datatype to use for this operation.
+ * @param[out] stream CUDA stream to enqueue the operation. This argument is ignored if the model is on the CPU.
+ *
+ * @return \p TORCHFORT_RESULT_SUCCESS on success or error code on failure.
+ */
+torchfort_result_t torchfort_inference_mc(const char* name, void* input, size_t input_dim, int64_t* input_shape,
+                                          int64_t n_samples, void* mean, size_t mean_dim, int64_t* mean_shape,
+                                          void* var, size_t var_dim, int64_t* var_shape, torchfort_datatype_t dtype,
+                                          cudaStream_t stream);
+
+torchfort_result_t torchfort_inference_mc_F(const char* name, void* input, size_t input_dim, int64_t* input_shape,
+                                            int64_t n_samples, void* mean, size_t mean_dim, int64_t* mean_shape,
+                                            void* var, size_t var_dim, int64_t* var_shape, torchfort_datatype_t dtype,
+                                            cudaStream_t stream);
+
+/**
+ * @brief Creates an inference pipeline chaining previously created model instances, as described in a YAML
+ * configuration file.
+ *
+ * @param[in] name A name to assign to the created pipeline instance to use as a key for other TorchFort routines.
+ * @param[in] config_fname The filesystem path to the user-defined pipeline configuration file to use.
+ *
+ * @return \p TORCHFORT_RESULT_SUCCESS on success or error code on failure.
+ */
+torchfort_result_t torchfort_create_pipeline(const char* name, const char* config_fname);
+
+/**
+ * @brief Runs inference through all stages of a pipeline using provided input data. Intermediate outputs remain in
+ * library-owned tensors.
+ *
+ * @param[in] name The name of pipeline instance to use, as defined during pipeline creation.
+ * @param[in] input A pointer to a memory buffer containing input data.
+ * @param[in] input_dim Rank of the input data.
+ * @param[in] input_shape A pointer to an array specifying the shape of the input data. Length should be equal to the
+ * rank of the input data.
+ * @param[in,out] output A pointer to a memory buffer to write output data.
+ * @param[in] output_dim Rank of the output data.
+ * @param[in] output_shape  A pointer to an array specifying the shape of the output data. Length should be equal to the
+ * rank of the output data.
+ * @param[out] dtype The TorchFort datatype to use for this operation.
+ * @param[out] stream CUDA stream to enqueue the operation. This argument is ignored if the first stage model is on the
+ * CPU.
+ *
+ * @return \p TORCHFORT_RESULT_SUCCESS on success or error code on failure.
+ */
+torchfort_result_t torchfort_inference_pipeline(const char* name, void* input, size_t input_dim, int64_t* input_shape,
+                                                void* output, size_t output_dim, int64_t* output_shape,
+                                                torchfort_datatype_t dtype, cudaStream_t stream);
+
+torchfort_result_t torchfort_inference_pipeline_F(const char* name, void* input, size_t input_dim,
+                                                  int64_t* input_shape, void* output, size_t output_dim,
+                                                  int64_t* output_shape, torchfort_datatype_t dtype,
+                                                  cudaStream_t stream);
+
 // Model/Checkpoint save and loading functions
 /**
  * @brief Saves a model to file.
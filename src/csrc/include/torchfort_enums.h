@@ -37,6 +37,15 @@
  */
 enum torchfort_datatype_t { TORCHFORT_FLOAT = -1, TORCHFORT_DOUBLE = -2 };
 
+/**
+ * @brief This enum defines which output of a model ensemble is returned by inference.
+ */
+enum torchfort_ensemble_output_t {
+  TORCHFORT_ENSEMBLE_MEAN = 0,     ///< Mean over ensemble members
+  TORCHFORT_ENSEMBLE_VARIANCE = 1, ///< Variance over ensemble members
+  TORCHFORT_ENSEMBLE_ALL = 2       ///< Outputs of all members, stacked along a new slowest varying dimension
+};
+
 /**
  * @brief This enum defines the possible values return values from TorchFort. Most functions in the TorchFort library
  * will return one of these values to indicate if an operation has completed successfully or an error occured.
@@ -251,6 +251,41 @@ torchfort_result_t torchfort_rl_off_policy_update_replay_buffer_F(const char* na
                                                                   bool final_state, torchfort_datatype_t dtype,
                                                                   cudaStream_t stream);
 
+/**
+ * @brief Adds one \f$(s, a, s', r, d)\f$ tuple per agent to the replay buffer of a multi-agent system
+ * @details In multi-agent mode, all agents share the policy and critic models as well as the replay buffer. The leading
+ * dimension of the state and action data is the agent index, consistent with the batch passed to \p
+ * torchfort_rl_off_policy_predict_explore. The number of agents has to be the same for all updates of a replay buffer.
+ * The transitions of all agents share the terminal state flag \f$d\f$.
+ *
+ * @param[in] name The name of system instance to use, as defined during system creation.
+ * @param[in] state_old A pointer to a memory buffer containing previous state data of all agents.
+ * @param[in] state_new A pointer to a memory buffer containing new state data of all agents.
+ * @param[in] state_dim Rank of the state data, including the agent dimension.
+ * @param[in] state_shape A pointer to an array specifying the shape of the state data. Length should be equal to the
+ * rank of the \p state_old and \p state_new data.
+ * @param[in] action_old A pointer to a memory buffer containing action data of all agents.
+ * @param[in] action_dim Rank of the action data, including the agent dimension.
+ * @param[in] action_shape A pointer to an array specifying the shape of the action data. Length should be equal to the
+ * rank of the action data.
+ * @param[in] reward A pointer to a memory buffer with one reward value per agent.
+ * @param[in] final_state A flag indicating whether \p state_new is the final state in the current episode (set to \p
+ * true if it is the final state, otherwise \p false).
+ * @param[in] dtype The TorchFort datatype to use for this operation.
+ * @param[in] stream CUDA stream to enqueue the operation. This argument is ignored if the model is on the CPU.
+ *
+ * @return \p TORCHFORT_RESULT_SUCCESS on success or error code on failure.
+ */
+torchfort_result_t torchfort_rl_off_policy_update_replay_buffer_multi_agent(
+    const char* name, void* state_old, void* state_new, size_t state_dim, int64_t* state_shape, void* action_old,
+    size_t action_dim, int64_t* action_shape, const void* reward, bool final_state, torchfort_datatype_t dtype,
+    cudaStream_t stream);
+
+torchfort_result_t torchfort_rl_off_policy_update_replay_buffer_multi_agent_F(
+    const char* name, void* state_old, void* state_new, size_t state_dim, int64_t* state_shape, void* action_old,
+    size_t action_dim, int64_t* action_shape, const void* reward, bool final_state, torchfort_datatype_t dtype,
+    cudaStream_t stream);
+
 // RL off-policy checkpoint save and loading functions
 /**
  * @brief Saves a reinforcement learning training checkpoint to a directory.
@@ -279,6 +314,20 @@ torchfort_result_t torchfort_rl_off_policy_save_checkpoint(const char* name, con
  */
 torchfort_result_t torchfort_rl_off_policy_load_checkpoint(const char* name, const char* checkpoint_dir);
 
+/**
+ * @brief Exports the deterministic policy of a reinforcement learning system as a TorchScript module.
+ * @details The exported module maps a batch of states to the actions returned by \p torchfort_rl_off_policy_predict,
+ * including output squashing and the mapping to \f$[a_{low}, a_{high}]\f$. The module is frozen and can be loaded
+ * with \p torchfort_create_model and evaluated with \p torchfort_inference without the reinforcement learning system.
+ * Policies given as TorchScript models and native MLP policies can be exported.
+ *
+ * @param[in] name The name of a system instance to export the policy for, as defined during system creation.
+ * @param[in] fname The filename to save the TorchScript module to.
+ *
+ * @return \p TORCHFORT_RESULT_SUCCESS on success or error code on failure.
+ */
+torchfort_result_t torchfort_rl_off_policy_export_policy(const char* name, const char* fname);
+
 // RL off-policy miscellaneous utility functions
 /**
  * @brief Queries a reinforcement learning system for rediness to start training
@@ -293,6 +342,36 @@ torchfort_result_t torchfort_rl_off_policy_load_checkpoint(const char* name, con
  */
 torchfort_result_t torchfort_rl_off_policy_is_ready(const char* name, bool& ready);
 
+/**
+ * @brief Resets the exploration noise of a reinforcement learning system for one or all environments
+ * @details This method should be called when an episode terminates, so that the next episode of this environment
+ * starts from a freshly drawn noise state. Only noise actors which carry state across steps (\p space_noise_ou) are
+ * affected, for all other noise actors this is a no-op.
+ *
+ * @param[in] name The name of a system instance to reset the exploration noise for, as defined during system creation.
+ * @param[in] env_id The environment index, i.e. the row of the state batch passed to the exploration routines. A
+ * negative value resets the noise of all environments.
+ * @param[in] stream CUDA stream to enqueue the operation. This argument is ignored if the model is on the CPU.
+ *
+ * @return \p TORCHFORT_RESULT_SUCCESS on success or error code on failure.
+ */
+torchfort_result_t torchfort_rl_off_policy_reset_exploration_noise(const char* name, int64_t env_id,
+                                                                   cudaStream_t stream);
+
+/**
+ * @brief Stops the asynchronous policy replication of a distributed reinforcement learning system
+ * @details This is a collective operation which has to be called on all ranks of the system before \p MPI_Finalize
+ * if \p policy_sync_interval is enabled. Actor-only ranks drain the pending policy broadcasts and keep the last
+ * received policy. Afterwards no communication of the replication is pending. For systems without policy
+ * replication, this is a no-op.
+ *
+ * @param[in] name The name of a system instance to stop the policy replication for, as defined during system
+ * creation.
+ *
+ * @return \p TORCHFORT_RESULT_SUCCESS on success or error code on failure.
+ */
+torchfort_result_t torchfort_rl_off_policy_stop_policy_sync(const char* name);
+
 // RL off-policy Weights and Bias Logging functions
 /**
  * @brief Write an integer value to a Weights and Bias log using the system logging tag.  \p *_float and \p *_double
@@ -535,6 +614,20 @@ torchfort_result_t torchfort_rl_on_policy_save_checkpoint(const char* name, cons
  */
 torchfort_result_t torchfort_rl_on_policy_load_checkpoint(const char* name, const char* checkpoint_dir);
 
+/**
+ * @brief Exports the deterministic policy of a reinforcement learning system as a TorchScript module.
+ * @details The exported module maps a batch of states to the actions returned by \p torchfort_rl_on_policy_predict,
+ * including output squashing and the mapping to \f$[a_{low}, a_{high}]\f$. The module is frozen and can be loaded
+ * with \p torchfort_create_model and evaluated with \p torchfort_inference without the reinforcement learning system.
+ * Policies given as TorchScript models and native MLP policies can be exported.
+ *
+ * @param[in] name The name of a system instance to export the policy for, as defined during system creation.
+ * @param[in] fname The filename to save the TorchScript module to.
+ *
+ * @return \p TORCHFORT_RESULT_SUCCESS on success or error code on failure.
+ */
+torchfort_result_t torchfort_rl_on_policy_export_policy(const char* name, const char* fname);
+
 // RL on-policy miscellaneous utility functions
 /**
  * @brief Queries a reinforcement learning system for rediness to start training
@@ -65,4 +65,14 @@ std::vector<torch::Tensor> L1Loss::forward(const std::vector<torch::Tensor>& inp
   return std::vector<torch::Tensor>{module(x.flatten(), y.flatten())};
 }
 
+std::vector<torch::Tensor> L1Loss::forward_weighted(const std::vector<torch::Tensor>& inputs,
+                                                    const std::vector<torch::Tensor>& labels,
+                                                    const torch::Tensor& weights, torch::Tensor& sample_losses) {
+  auto x = inputs[0];
+  auto y = labels[0];
+  auto elementwise = torch::nn::functional::l1_loss(x.reshape({x.size(0), -1}), y.reshape({y.size(0), -1}),
+                                                    torch::nn::functional::L1LossFuncOptions(torch::kNone));
+  return std::vector<torch::Tensor>{reduce_weighted(elementwise, weights, module->options.reduction(), sample_losses)};
+}
+
 } // namespace torchfort
@@ -0,0 +1,79 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2023 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "internal/base_lr_scheduler.h"
+#include "internal/lr_schedulers.h"
+
+namespace torchfort {
+
+BatchGrowthLR::BatchGrowthLR(torch::optim::Optimizer& optimizer, const unsigned step_size, const unsigned growth_factor,
+                             const unsigned max_factor, const BatchScalingRule scaling)
+    : BaseLRScheduler(optimizer), step_size_(step_size), growth_factor_(growth_factor), max_factor_(max_factor),
+      scaling_(scaling) {
+  base_lrs_ = get_current_lrs();
+}
+
+int64_t BatchGrowthLR::factor_at(const int64_t step) const {
+  int64_t max_factor = max_factor_;
+  int64_t factor = 1;
+  for (int64_t i = 0; i < step / step_size_ && factor < max_factor; ++i) {
+    factor *= growth_factor_;
+  }
+  return std::min(factor, max_factor);
+}
+
+int64_t BatchGrowthLR::batch_factor() const { return factor_at(step_count_); }
+
+std::vector<double> BatchGrowthLR::get_lrs() {
+  // the learning rates set here are used by the next step, which runs with the batch factor of step_count_ + 1
+  double factor = factor_at(step_count_ + 1);
+  double scale = 1.0;
+  switch (scaling_) {
+  case LinearScaling:
+    scale = factor;
+    break;
+  case SqrtScaling:
+    scale = std::sqrt(factor);
+    break;
+  case NoScaling:
+    break;
+  }
+
+  std::vector<double> lrs;
+  std::transform(base_lrs_.begin(), base_lrs_.end(), std::back_inserter(lrs),
+                 [scale](const double& base) { return scale * base; });
+  return lrs;
+}
+
+} // namespace torchfort
@@ -155,6 +155,38 @@ std::shared_ptr<BaseLRScheduler> get_lr_scheduler(const YAML::Node& lr_scheduler
     }
 
     lr_scheduler = std::shared_ptr<BaseLRScheduler>(new LinearLR(*optimizer, total_iters, start_factor, end_factor));
+  } else if (type == "batch_growth") {
+    std::set<std::string> supported_params{"step_size", "growth_factor", "max_factor", "lr_scaling"};
+    check_params(supported_params, params.keys());
+
+    int step_size;
+    try {
+      step_size = params.get_param<int>("step_size")[0];
+    } catch (std::out_of_range) {
+      THROW_INVALID_USAGE("batch_growth_lr: step_size parameter is required.");
+    }
+
+    int growth_factor = params.get_param<int>("growth_factor", 2)[0];
+    int max_factor = params.get_param<int>("max_factor", 8)[0];
+    if (step_size <= 0 || growth_factor < 1 || max_factor < 1) {
+      THROW_INVALID_USAGE("batch_growth_lr: step_size, growth_factor and max_factor must be positive.");
+    }
+
+    BatchScalingRule scaling;
+    auto scaling_name = sanitize(params.get_param<std::string>("lr_scaling", "linear")[0]);
+    if (scaling_name == "linear") {
+      scaling = LinearScaling;
+    } else if (scaling_name == "sqrt") {
+      scaling = SqrtScaling;
+    } else if (scaling_name == "none") {
+      scaling = NoScaling;
+    } else {
+      THROW_INVALID_USAGE("batch_growth_lr: unknown lr_scaling " + scaling_name +
+                          ". Supported rules are: linear, sqrt, none.");
+    }
+
+    lr_scheduler = std::shared_ptr<BaseLRScheduler>(
+        new BatchGrowthLR(*optimizer, step_size, growth_factor, max_factor, scaling));
   } else {
     THROW_INVALID_USAGE("Unknown lr_scheduler type provided.");
   }
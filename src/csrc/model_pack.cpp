@@ -67,6 +67,11 @@ void save_model_pack(const ModelPack& model_pack, const std::string& dir, bool s
 
   auto state_path = root_dir / "state.pt";
   model_pack.state->save(state_path.native());
+
+  if (model_pack.normalizer) {
+    auto normalization_path = root_dir / "normalization.pt";
+    model_pack.normalizer->save(normalization_path.native());
+  }
 }
 
 void load_model_pack(ModelPack& model_pack, const std::string& dir, bool load_optimizer) {
@@ -84,11 +89,16 @@ void load_model_pack(ModelPack& model_pack, const std::string& dir, bool load_op
   }
   model_pack.model->load(model_path.native());
 
+  auto normalization_path = root_dir / "normalization.pt";
+  if (model_pack.normalizer && std::filesystem::exists(normalization_path)) {
+    model_pack.normalizer->load(normalization_path.native());
+  }
+
   // Assign optimizer to parameters of loaded model:
   // we need to check if the optimizer is initialized before doing so
   // (some RL models do not have an optimizer attached to them):
   if (model_pack.optimizer) {
-    model_pack.optimizer->parameters() = model_pack.model->parameters();
+    model_pack.optimizer->parameters() = model_pack.model->trainable_parameters();
   }
 
   if (load_optimizer) {
@@ -68,6 +68,9 @@ void ModelState::load(const std::string& fname) {
     THROW_INVALID_USAGE(fname + " is missing required data.");
   }
   device = ivalue.to<torch::Device>();
+
+  // accumulated gradients are not restored, start a new accumulation window
+  accumulation_step = 0;
 }
 
 } // namespace torchfort
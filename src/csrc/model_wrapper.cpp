@@ -33,10 +33,13 @@
 #include <string>
 #include <vector>
 
+#include <fnmatch.h>
+
 #include <cuda_runtime.h>
 #include <torch/script.h>
 #include <torch/torch.h>
 
+#include "internal/activation_checkpointing.h"
 #include "internal/base_model.h"
 #include "internal/defines.h"
 #include "internal/model_wrapper.h"
@@ -82,6 +85,45 @@ torch::OrderedDict<std::string, torch::Tensor> ModelWrapper::named_parameters()
   return model->named_parameters();
 }
 
+std::vector<torch::Tensor> ModelWrapper::trainable_parameters() const {
+  std::vector<torch::Tensor> parameters;
+  for (const auto& p : this->parameters()) {
+    if (p.requires_grad()) {
+      parameters.push_back(p);
+    }
+  }
+  return parameters;
+}
+
+void ModelWrapper::set_trainable_parameters(const std::vector<std::string>& patterns) {
+  trainable_patterns = patterns;
+  apply_trainable_patterns();
+}
+
+void ModelWrapper::apply_trainable_patterns() {
+  if (trainable_patterns.empty()) {
+    return;
+  }
+
+  // frozen parameters receive no gradients, so autograd does not record operations on frozen leading layers
+  int64_t n_trainable = 0;
+  for (auto& item : named_parameters()) {
+    bool trainable = false;
+    for (const auto& pattern : trainable_patterns) {
+      if (fnmatch(pattern.c_str(), item.key().c_str(), 0) == 0) {
+        trainable = true;
+        break;
+      }
+    }
+    item.value().requires_grad_(trainable);
+    n_trainable += trainable;
+  }
+
+  if (n_trainable == 0) {
+    THROW_INVALID_USAGE("trainable_parameters patterns do not match any model parameter.");
+  }
+}
+
 void ModelWrapper::to(torch::Device device, bool non_blocking) {
   if (jit) {
     model_jit->to(device, non_blocking);
@@ -108,8 +150,56 @@ void ModelWrapper::eval() {
   }
 }
 
+void ModelWrapper::eval_mc_dropout() {
+  if (jit) {
+    // only switch dropout submodules back to training mode so that e.g. batch norm keeps its running statistics
+    model_jit->eval();
+    for (auto submodule : model_jit->modules()) {
+      auto type_name = submodule.type()->name();
+      if (type_name && type_name->name().find("Dropout") != std::string::npos) {
+        submodule.train(true);
+      }
+    }
+  } else {
+    // native models only use the training flag to enable dropout
+    model->train();
+  }
+}
+
+static std::vector<torch::Tensor> jit_result_to_tensors(const torch::jit::IValue& result) {
+  if (result.isTensor()) {
+    return std::vector<torch::Tensor>{result.toTensor()};
+  }
+  std::vector<torch::Tensor> tensors;
+  for (const auto& x : result.toTuple()->elements()) {
+    tensors.push_back(x.toTensor());
+  }
+  return tensors;
+}
+
+std::vector<torch::Tensor> ModelWrapper::forward_jit_checkpointed(const std::vector<torch::Tensor>& inputs) const {
+  // Segments are formed along the children of the scripted torch.nn.Sequential container.
+  std::vector<SegmentFunction> layers;
+  std::vector<std::vector<torch::Tensor>> layer_params;
+  for (const auto& child : model_jit->children()) {
+    layers.push_back([child](const std::vector<torch::Tensor>& inputs) mutable {
+      std::vector<torch::jit::IValue> inputs_jit(inputs.begin(), inputs.end());
+      return jit_result_to_tensors(child.forward(inputs_jit));
+    });
+    layer_params.emplace_back();
+    for (const auto& p : child.parameters()) {
+      layer_params.back().push_back(p);
+    }
+  }
+
+  return checkpoint_sequential(layers, layer_params, checkpoint_segments, inputs);
+}
+
 std::vector<torch::Tensor> ModelWrapper::forward(const std::vector<torch::Tensor>& inputs) const {
   if (jit) {
+    if (checkpoint_segments > 0 && model_jit->is_training()) {
+      return forward_jit_checkpointed(inputs);
+    }
     std::vector<torch::jit::IValue> inputs_jit;
     inputs_jit.assign(inputs.begin(), inputs.end());
     auto result = model_jit->forward(inputs_jit);
@@ -149,6 +239,8 @@ void ModelWrapper::load(const std::string& fname) {
     model_jit = std::shared_ptr<torch::jit::Module>(new torch::jit::Module);
 
     *model_jit = torch::jit::load(fname, device_);
+    // the loaded module holds new parameters
+    apply_trainable_patterns();
   } else {
     model->to(torch::Device(torch::kCPU));
     torch::load(model, fname);
@@ -160,4 +252,60 @@ torch::Device ModelWrapper::device() const {
   return device_;
 }
 
+bool ModelWrapper::stateful() const {
+  if (jit) {
+    return jit_stateful;
+  }
+  return model->stateful();
+}
+
+void ModelWrapper::set_stateful(bool flag) {
+  if (!jit) {
+    THROW_INVALID_USAGE("stateful can only be set for torchscript models.");
+  }
+  jit_stateful = flag;
+}
+
+int ModelWrapper::ensemble_size() const {
+  if (jit) {
+    return 1;
+  }
+  return model->ensemble_size();
+}
+
+std::shared_ptr<BaseModel> ModelWrapper::native_model() const {
+  if (jit) {
+    return nullptr;
+  }
+  return model;
+}
+
+std::shared_ptr<torch::jit::Module> ModelWrapper::jit_model() const {
+  if (!jit) {
+    return nullptr;
+  }
+  return model_jit;
+}
+
+void ModelWrapper::enable_activation_checkpointing(int num_segments) {
+  if (!jit) {
+    THROW_INVALID_USAGE("activation checkpointing for native models is configured through the model parameters.");
+  }
+  if (num_segments < 0) {
+    THROW_INVALID_USAGE("checkpoint_segments must be a positive integer.");
+  }
+  auto type_name = model_jit->type()->name();
+  if (!type_name || type_name->name() != "Sequential") {
+    THROW_INVALID_USAGE("activation checkpointing for torchscript models requires a scripted torch.nn.Sequential module.");
+  }
+  if (num_segments == 0) {
+    int num_layers = 0;
+    for (const auto& child : model_jit->children()) {
+      num_layers++;
+    }
+    num_segments = default_checkpoint_segments(num_layers);
+  }
+  checkpoint_segments = num_segments;
+}
+
 } // namespace torchfort
@@ -0,0 +1,68 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2023 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <torch/torch.h>
+
+#include "internal/exceptions.h"
+#include "internal/models.h"
+#include "internal/param_map.h"
+
+namespace torchfort {
+
+EnsembleModel::EnsembleModel(const std::function<std::shared_ptr<BaseModel>()>& factory, int n_members) {
+  for (int i = 0; i < n_members; ++i) {
+    members.push_back(register_module("member" + std::to_string(i), factory()));
+  }
+}
+
+void EnsembleModel::setup(const ParamMap& params) {
+  // every member draws its own initial weights
+  for (auto& member : members) {
+    member->setup(params);
+  }
+  if (members[0]->stateful()) {
+    THROW_NOT_SUPPORTED("Ensembles of stateful models are not supported.");
+  }
+}
+
+std::vector<torch::Tensor> EnsembleModel::forward(const std::vector<torch::Tensor>& inputs) {
+  std::vector<torch::Tensor> outputs;
+  outputs.reserve(members.size());
+  for (auto& member : members) {
+    outputs.push_back(member->forward(inputs)[0]);
+  }
+  return std::vector<torch::Tensor>{torch::stack(outputs, 0)};
+}
+
+} // namespace torchfort
@@ -0,0 +1,186 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2023 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+#include <vector>
+
+#include <torch/torch.h>
+
+#include "internal/exceptions.h"
+#include "internal/models.h"
+#include "internal/param_map.h"
+#include "internal/setup.h"
+
+namespace torchfort {
+
+// Helper functions for the FNO model
+namespace {
+
+// Initialize weights and biases of a pointwise layer like torch::nn::Linear
+std::pair<torch::Tensor, torch::Tensor> init_pointwise(int in_channels, int out_channels) {
+  double bound = 1.0 / std::sqrt(static_cast<double>(in_channels));
+  auto weight = torch::empty({out_channels, in_channels}).uniform_(-bound, bound);
+  auto bias = torch::empty({out_channels}).uniform_(-bound, bound);
+  return {weight, bias};
+}
+
+// Apply a pointwise linear layer to a channel-first tensor [batch, channels, d_1, ..., d_k].
+// The spatial dims are flattened so that this is a single batched GEMM without any permutation.
+torch::Tensor pointwise(const torch::Tensor& x, const torch::Tensor& weight, const torch::Tensor& bias) {
+  auto sizes = x.sizes().vec();
+  sizes[1] = weight.size(0);
+  auto y = torch::matmul(weight, x.flatten(2)) + bias.unsqueeze(-1);
+  return y.view(sizes);
+}
+
+} // namespace
+
+void FNOModel::setup(const ParamMap& params) {
+  // Extract params from input map.
+  std::set<std::string> supported_params{"in_channels", "out_channels", "width",
+                                         "projection_width", "num_layers", "modes"};
+  check_params(supported_params, params.keys());
+
+  try {
+    in_channels = params.get_param<int>("in_channels")[0];
+    out_channels = params.get_param<int>("out_channels")[0];
+    modes = params.get_param<int>("modes");
+  } catch (std::out_of_range) {
+    THROW_INVALID_USAGE("in_channels, out_channels and modes parameters are required for FNO model type.");
+  }
+  width = params.get_param<int>("width", 32)[0];
+  projection_width = params.get_param<int>("projection_width", 128)[0];
+  num_layers = params.get_param<int>("num_layers", 4)[0];
+
+  if (modes.empty()) {
+    THROW_INVALID_USAGE("modes must contain one entry per spatial dimension.");
+  }
+
+  // Number of retained Fourier modes: all dims but the last keep the lowest positive and negative
+  // frequencies, the last (halved by rfft) only keeps the positive ones.
+  int64_t n_modes = 1;
+  for (int i = 0; i < modes.size(); ++i) {
+    n_modes *= (i < modes.size() - 1) ? 2 * modes[i] : modes[i];
+  }
+
+  // Construct and register parameters.
+  auto [lw, lb] = init_pointwise(in_channels, width);
+  lift_weight = register_parameter("lift_weight", lw);
+  lift_bias = register_parameter("lift_bias", lb);
+
+  double scale = 1.0 / (static_cast<double>(width) * width);
+  for (int i = 0; i < num_layers; ++i) {
+    spectral_weights.push_back(
+        register_parameter("spectral_weight" + std::to_string(i), scale * torch::rand({n_modes, width, width, 2})));
+    auto [w, b] = init_pointwise(width, width);
+    bypass_weights.push_back(register_parameter("bypass_weight" + std::to_string(i), w));
+    bypass_biases.push_back(register_parameter("bypass_bias" + std::to_string(i), b));
+  }
+
+  auto [pw, pb] = init_pointwise(width, projection_width);
+  proj_weight = register_parameter("proj_weight", pw);
+  proj_bias = register_parameter("proj_bias", pb);
+  auto [ow, ob] = init_pointwise(projection_width, out_channels);
+  out_weight = register_parameter("out_weight", ow);
+  out_bias = register_parameter("out_bias", ob);
+}
+
+torch::Tensor FNOModel::spectral_conv(const torch::Tensor& x, const torch::Tensor& weight) const {
+  int ndim = modes.size();
+  std::vector<int64_t> fft_dims(ndim), fft_sizes(ndim);
+  for (int i = 0; i < ndim; ++i) {
+    fft_dims[i] = i + 2;
+    fft_sizes[i] = x.size(i + 2);
+  }
+
+  auto x_ft = torch::fft::rfftn(x, c10::nullopt, fft_dims);
+
+  // Each corner of the spectrum holding retained modes is selected by a bit per dim (but the last):
+  // 0 picks the positive, 1 the negative frequencies.
+  int n_corners = 1 << (ndim - 1);
+  auto corner = [&](torch::Tensor t, int c) {
+    for (int i = 0; i < ndim; ++i) {
+      int64_t start = ((i < ndim - 1) && (c & (1 << i))) ? t.size(i + 2) - modes[i] : 0;
+      t = t.narrow(i + 2, start, modes[i]);
+    }
+    return t;
+  };
+
+  // Gather the truncated modes into [n_modes, batch, width] and mix channels with one batched complex GEMM.
+  std::vector<torch::Tensor> blocks;
+  for (int c = 0; c < n_corners; ++c) {
+    blocks.push_back(corner(x_ft, c).reshape({x.size(0), x.size(1), -1}));
+  }
+  auto x_modes = torch::cat(blocks, 2).permute({2, 0, 1});
+  auto y_modes = torch::bmm(x_modes, torch::view_as_complex(weight)).permute({1, 2, 0});
+
+  // Scatter back into an otherwise zero spectrum.
+  auto y_ft = torch::zeros_like(x_ft);
+  int64_t offset = 0;
+  for (int c = 0; c < n_corners; ++c) {
+    auto block = corner(y_ft, c);
+    auto block_size = block.numel() / (block.size(0) * block.size(1));
+    block.copy_(y_modes.narrow(2, offset, block_size).reshape(block.sizes()));
+    offset += block_size;
+  }
+
+  return torch::fft::irfftn(y_ft, fft_sizes, fft_dims);
+}
+
+// Implement the forward function.
+std::vector<torch::Tensor> FNOModel::forward(const std::vector<torch::Tensor>& inputs) {
+  auto x = inputs[0];
+
+  int ndim = modes.size();
+  if (x.dim() != ndim + 2 || x.size(1) != in_channels) {
+    THROW_INVALID_USAGE("FNO model expects input of shape [batch, in_channels, d_1, ..., d_k] with one entry in modes "
+                        "per spatial dimension.");
+  }
+  for (int i = 0; i < ndim; ++i) {
+    int64_t max_modes = (i < ndim - 1) ? x.size(i + 2) / 2 : x.size(i + 2) / 2 + 1;
+    if (modes[i] > max_modes) {
+      THROW_INVALID_USAGE("FNO modes exceed the number of Fourier modes available for the input grid.");
+    }
+  }
+
+  x = pointwise(x, lift_weight, lift_bias);
+  for (int i = 0; i < num_layers; ++i) {
+    x = spectral_conv(x, spectral_weights[i]) + pointwise(x, bypass_weights[i], bypass_biases[i]);
+    if (i < num_layers - 1) {
+      x = torch::gelu(x);
+    }
+  }
+  x = torch::gelu(pointwise(x, proj_weight, proj_bias));
+  x = pointwise(x, out_weight, out_bias);
+
+  return std::vector<torch::Tensor>{x};
+}
+
+} // namespace torchfort
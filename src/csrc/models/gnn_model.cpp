@@ -0,0 +1,193 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2023 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include <torch/torch.h>
+
+#include "internal/exceptions.h"
+#include "internal/models.h"
+#include "internal/param_map.h"
+#include "internal/setup.h"
+
+namespace torchfort {
+
+// Helper functions for the GNN model
+namespace {
+
+// Spread the lower 32 bits of v to the even bits of the result
+uint64_t spread_bits(uint64_t v) {
+  v &= 0x00000000FFFFFFFFULL;
+  v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+  v = (v | (v << 8)) & 0x00FF00FF00FF00FFULL;
+  v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  v = (v | (v << 2)) & 0x3333333333333333ULL;
+  v = (v | (v << 1)) & 0x5555555555555555ULL;
+  return v;
+}
+
+// Position of edge (dst, src) along the Z-order curve over the adjacency matrix
+uint64_t morton_key(int64_t dst, int64_t src) {
+  return (spread_bits(static_cast<uint64_t>(dst)) << 1) | spread_bits(static_cast<uint64_t>(src));
+}
+
+} // namespace
+
+void GNNModel::setup(const ParamMap& params) {
+  // Extract params from input map.
+  std::set<std::string> supported_params{"in_channels", "out_channels", "hidden_channels", "num_layers",
+                                         "aggregation"};
+  check_params(supported_params, params.keys());
+
+  try {
+    in_channels = params.get_param<int>("in_channels")[0];
+    out_channels = params.get_param<int>("out_channels")[0];
+  } catch (std::out_of_range) {
+    THROW_INVALID_USAGE("in_channels and out_channels parameters are required for GNN model type.");
+  }
+  hidden_channels = params.get_param<int>("hidden_channels", 64)[0];
+  num_layers = params.get_param<int>("num_layers", 4)[0];
+
+  auto aggregation = sanitize(params.get_param<std::string>("aggregation", "sum")[0]);
+  if (aggregation == "sum") {
+    mean_aggregation = false;
+  } else if (aggregation == "mean") {
+    mean_aggregation = true;
+  } else {
+    THROW_INVALID_USAGE("Unknown aggregation " + aggregation + " requested. Supported aggregations are: sum, mean.");
+  }
+
+  // Construct and register submodules.
+  encoder = register_module("encoder", torch::nn::Linear(in_channels, hidden_channels));
+  for (int i = 0; i < num_layers; ++i) {
+    auto no_bias = torch::nn::LinearOptions(hidden_channels, hidden_channels).bias(false);
+    msg_dst_layers.push_back(
+        register_module("msg_dst" + std::to_string(i), torch::nn::Linear(hidden_channels, hidden_channels)));
+    msg_src_layers.push_back(register_module("msg_src" + std::to_string(i), torch::nn::Linear(no_bias)));
+    upd_node_layers.push_back(
+        register_module("upd_node" + std::to_string(i), torch::nn::Linear(hidden_channels, hidden_channels)));
+    upd_agg_layers.push_back(register_module("upd_agg" + std::to_string(i), torch::nn::Linear(no_bias)));
+  }
+  decoder = register_module("decoder", torch::nn::Linear(hidden_channels, out_channels));
+}
+
+void GNNModel::set_graph(int64_t n_nodes, torch::Tensor row_offsets, torch::Tensor col_indices, int64_t index_base) {
+  auto offsets = (row_offsets.to(torch::kCPU, torch::kInt64) - index_base).contiguous();
+  auto cols = (col_indices.to(torch::kCPU, torch::kInt64) - index_base).contiguous();
+  int64_t n_edges = cols.numel();
+
+  if (offsets.numel() != n_nodes + 1) {
+    THROW_INVALID_USAGE("row_offsets must have n_nodes + 1 entries.");
+  }
+  auto off = offsets.data_ptr<int64_t>();
+  auto col = cols.data_ptr<int64_t>();
+  if (off[0] != 0 || off[n_nodes] != n_edges) {
+    THROW_INVALID_USAGE("row_offsets are inconsistent with the number of edges.");
+  }
+
+  // Expand CSR rows to per-edge destinations and compute the Z-order position of every edge.
+  std::vector<int64_t> dst(n_edges);
+  std::vector<uint64_t> keys(n_edges);
+  for (int64_t i = 0; i < n_nodes; ++i) {
+    if (off[i + 1] < off[i]) {
+      THROW_INVALID_USAGE("row_offsets must be non-decreasing.");
+    }
+    for (int64_t e = off[i]; e < off[i + 1]; ++e) {
+      if (col[e] < 0 || col[e] >= n_nodes) {
+        THROW_INVALID_USAGE("col_indices contain an out of range node index.");
+      }
+      dst[e] = i;
+      keys[e] = morton_key(i, col[e]);
+    }
+  }
+
+  std::vector<int64_t> perm(n_edges);
+  std::iota(perm.begin(), perm.end(), 0);
+  std::sort(perm.begin(), perm.end(), [&keys](int64_t a, int64_t b) { return keys[a] < keys[b]; });
+
+  auto src_sorted = torch::empty({n_edges}, torch::kInt64);
+  auto dst_sorted = torch::empty({n_edges}, torch::kInt64);
+  auto src_ptr = src_sorted.data_ptr<int64_t>();
+  auto dst_ptr = dst_sorted.data_ptr<int64_t>();
+  for (int64_t e = 0; e < n_edges; ++e) {
+    src_ptr[e] = col[perm[e]];
+    dst_ptr[e] = dst[perm[e]];
+  }
+
+  auto degree = (offsets.slice(0, 1) - offsets.slice(0, 0, n_nodes)).clamp_min(1);
+
+  auto device = encoder->weight.device();
+  this->n_nodes = n_nodes;
+  edge_src = src_sorted.to(device);
+  edge_dst = dst_sorted.to(device);
+  inv_degree = (1.0 / degree.to(encoder->weight.dtype())).unsqueeze(-1).to(device);
+}
+
+// Implement the forward function.
+std::vector<torch::Tensor> GNNModel::forward(const std::vector<torch::Tensor>& inputs) {
+  if (!edge_src.defined()) {
+    THROW_INVALID_USAGE("GNN model requires the graph connectivity to be registered with torchfort_set_graph.");
+  }
+
+  auto x = inputs[0];
+  if ((x.dim() != 2 && x.dim() != 3) || x.size(-2) != n_nodes || x.size(-1) != in_channels) {
+    THROW_INVALID_USAGE("GNN model expects input of shape [n_nodes, in_channels] or [batch, n_nodes, in_channels].");
+  }
+  int64_t node_dim = x.dim() - 2;
+
+  // Keep the cached graph next to the parameters.
+  if (edge_src.device() != x.device()) {
+    edge_src = edge_src.to(x.device());
+    edge_dst = edge_dst.to(x.device());
+  }
+  if (inv_degree.device() != x.device() || inv_degree.dtype() != x.dtype()) {
+    inv_degree = inv_degree.to(x.device(), x.dtype());
+  }
+
+  auto h = torch::relu(encoder->forward(x));
+  for (int i = 0; i < num_layers; ++i) {
+    // Transform on nodes first, then gather per edge: avoids GEMMs over the much larger edge set.
+    auto msg = torch::relu(msg_dst_layers[i]->forward(h).index_select(node_dim, edge_dst) +
+                           msg_src_layers[i]->forward(h).index_select(node_dim, edge_src));
+    auto agg = torch::zeros_like(h).index_add(node_dim, edge_dst, msg);
+    if (mean_aggregation) {
+      agg = agg * inv_degree;
+    }
+    h = h + torch::relu(upd_node_layers[i]->forward(h) + upd_agg_layers[i]->forward(agg));
+  }
+  x = decoder->forward(h);
+
+  return std::vector<torch::Tensor>{x};
+}
+
+} // namespace torchfort
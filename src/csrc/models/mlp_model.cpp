@@ -28,10 +28,13 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <cmath>
 #include <vector>
 
 #include <torch/torch.h>
 
+#include "internal/activation_checkpointing.h"
+#include "internal/exceptions.h"
 #include "internal/models.h"
 #include "internal/param_map.h"
 #include "internal/setup.h"
@@ -41,14 +44,35 @@ namespace torchfort {
 // MLP model in C++ using libtorch
 void MLPModel::setup(const ParamMap& params) {
   // Extract params from input map.
-  std::set<std::string> supported_params{"dropout", "layer_sizes"};
+  std::set<std::string> supported_params{"dropout", "layer_sizes", "checkpoint_activations", "checkpoint_segments",
+                                         "ensemble_size"};
   check_params(supported_params, params.keys());
 
   dropout = params.get_param<double>("dropout", 0.0)[0];
   layer_sizes = params.get_param<int>("layer_sizes");
+  checkpoint_activations = params.get_param<bool>("checkpoint_activations", false)[0];
+  checkpoint_segments =
+      params.get_param<int>("checkpoint_segments", default_checkpoint_segments(layer_sizes.size() - 1))[0];
+  if (checkpoint_segments < 1) {
+    THROW_INVALID_USAGE("checkpoint_segments must be a positive integer.");
+  }
+  n_members = params.get_param<int>("ensemble_size", 1)[0];
+  if (n_members < 1) {
+    THROW_INVALID_USAGE("ensemble_size must be a positive integer.");
+  }
 
   // Construct and register submodules.
   for (int i = 0; i < layer_sizes.size() - 1; ++i) {
+    if (n_members > 1) {
+      // Stacked member weights [n_members, in, out], initialized per member like torch::nn::Linear
+      double bound = 1.0 / std::sqrt(static_cast<double>(layer_sizes[i]));
+      ensemble_weights.push_back(register_parameter(
+          "w" + std::to_string(i),
+          torch::empty({n_members, layer_sizes[i], layer_sizes[i + 1]}).uniform_(-bound, bound)));
+      ensemble_biases.push_back(register_parameter(
+          "b" + std::to_string(i), torch::empty({n_members, 1, layer_sizes[i + 1]}).uniform_(-bound, bound)));
+      continue;
+    }
     fc_layers.push_back(
         register_module("fc" + std::to_string(i), torch::nn::Linear(layer_sizes[i], layer_sizes[i + 1])));
     if (i < layer_sizes.size() - 2) {
@@ -57,18 +81,59 @@ void MLPModel::setup(const ParamMap& params) {
   }
 }
 
+torch::Tensor MLPModel::layer_forward(int i, const torch::Tensor& x) {
+  torch::Tensor y;
+  if (n_members > 1) {
+    // all members in a single batched GEMM
+    y = torch::baddbmm(ensemble_biases[i], x, ensemble_weights[i]);
+  } else {
+    y = fc_layers[i]->forward(x);
+    if (i < layer_sizes.size() - 2) {
+      y = y + biases[i];
+    }
+  }
+  if (i < layer_sizes.size() - 2) {
+    y = torch::dropout(torch::relu(y), dropout, is_training());
+  }
+  return y;
+}
+
+std::vector<torch::Tensor> MLPModel::layer_parameters(int i) const {
+  if (n_members > 1) {
+    return {ensemble_weights[i], ensemble_biases[i]};
+  }
+  auto params = fc_layers[i]->parameters();
+  if (i < layer_sizes.size() - 2) {
+    params.push_back(biases[i]);
+  }
+  return params;
+}
+
 // Implement the forward function.
 std::vector<torch::Tensor> MLPModel::forward(const std::vector<torch::Tensor>& inputs) {
   auto x = inputs[0];
   x = x.reshape({x.size(0), -1});
 
-  for (int i = 0; i < layer_sizes.size() - 1; ++i) {
-    if (i < layer_sizes.size() - 2) {
-      x = torch::relu(fc_layers[i]->forward(x) + biases[i]);
-      x = torch::dropout(x, dropout, is_training());
-    } else {
-      x = fc_layers[i]->forward(x);
+  // ensemble members share the input, outputs are stacked as [n_members, batch, out]
+  if (n_members > 1) {
+    x = x.unsqueeze(0).expand({n_members, x.size(0), x.size(1)});
+  }
+
+  // recomputation only pays off when a backward pass follows, not for dropout-active inference
+  if (checkpoint_activations && is_training() && torch::GradMode::is_enabled()) {
+    std::vector<SegmentFunction> layers;
+    std::vector<std::vector<torch::Tensor>> layer_params;
+    for (int i = 0; i < layer_sizes.size() - 1; ++i) {
+      layers.push_back([this, i](const std::vector<torch::Tensor>& inputs) {
+        return std::vector<torch::Tensor>{layer_forward(i, inputs[0])};
+      });
+      layer_params.push_back(layer_parameters(i));
     }
+    return checkpoint_sequential(layers, layer_params, checkpoint_segments, {x});
+  }
+
+  for (int i = 0; i < layer_sizes.size() - 1; ++i) {
+    x = layer_forward(i, x);
   }
   return std::vector<torch::Tensor>{x};
 }
@@ -0,0 +1,127 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2023 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <vector>
+
+#include <torch/torch.h>
+
+#include "internal/exceptions.h"
+#include "internal/models.h"
+#include "internal/param_map.h"
+#include "internal/setup.h"
+
+namespace torchfort {
+
+void RNNModel::setup(const ParamMap& params) {
+  // Extract params from input map.
+  std::set<std::string> supported_params{"cell", "input_size", "hidden_size", "output_size", "num_layers", "dropout"};
+  check_params(supported_params, params.keys());
+
+  try {
+    input_size = params.get_param<int>("input_size")[0];
+    hidden_size = params.get_param<int>("hidden_size")[0];
+    output_size = params.get_param<int>("output_size")[0];
+  } catch (std::out_of_range) {
+    THROW_INVALID_USAGE("input_size, hidden_size and output_size parameters are required for RNN model type.");
+  }
+  num_layers = params.get_param<int>("num_layers", 1)[0];
+  dropout = params.get_param<double>("dropout", 0.0)[0];
+
+  auto cell = sanitize(params.get_param<std::string>("cell", "lstm")[0]);
+  if (cell == "lstm") {
+    use_lstm = true;
+  } else if (cell == "gru") {
+    use_lstm = false;
+  } else {
+    THROW_INVALID_USAGE("Unknown cell " + cell + " requested. Supported cells are: lstm, gru.");
+  }
+
+  // Construct and register submodules.
+  if (use_lstm) {
+    auto options = torch::nn::LSTMOptions(input_size, hidden_size).num_layers(num_layers).dropout(dropout);
+    lstm = register_module("lstm", torch::nn::LSTM(options.batch_first(true)));
+  } else {
+    auto options = torch::nn::GRUOptions(input_size, hidden_size).num_layers(num_layers).dropout(dropout);
+    gru = register_module("gru", torch::nn::GRU(options.batch_first(true)));
+  }
+  head = register_module("head", torch::nn::Linear(hidden_size, output_size));
+}
+
+// Implement the forward function.
+std::vector<torch::Tensor> RNNModel::forward(const std::vector<torch::Tensor>& inputs) {
+  auto x = inputs[0];
+  bool single_step = (x.dim() == 2);
+  if (single_step) {
+    x = x.unsqueeze(1);
+  }
+  if (x.dim() != 3 || x.size(-1) != input_size) {
+    THROW_INVALID_USAGE("RNN model expects input of shape [batch, input_size] or [batch, seq_len, input_size].");
+  }
+
+  // Hidden states are [num_layers, batch, hidden_size], a new zero state is used if none is provided.
+  auto check_state = [&](const torch::Tensor& h) {
+    if (h.size(1) != x.size(0)) {
+      THROW_INVALID_USAGE("Batch size of the input does not match the stored hidden state. Reset the state first.");
+    }
+  };
+
+  torch::Tensor y;
+  std::vector<torch::Tensor> state;
+  if (use_lstm) {
+    torch::optional<std::tuple<torch::Tensor, torch::Tensor>> hx;
+    if (inputs.size() == 3) {
+      check_state(inputs[1]);
+      hx = std::make_tuple(inputs[1], inputs[2]);
+    }
+    auto [out, hc] = lstm->forward(x, hx);
+    y = out;
+    state = {std::get<0>(hc), std::get<1>(hc)};
+  } else {
+    torch::Tensor hx;
+    if (inputs.size() == 2) {
+      check_state(inputs[1]);
+      hx = inputs[1];
+    }
+    auto [out, h] = gru->forward(x, hx);
+    y = out;
+    state = {h};
+  }
+
+  y = head->forward(y);
+  if (single_step) {
+    y = y.squeeze(1);
+  }
+
+  std::vector<torch::Tensor> results{y};
+  results.insert(results.end(), state.begin(), state.end());
+  return results;
+}
+
+} // namespace torchfort
@@ -0,0 +1,270 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2023 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include <torch/torch.h>
+#include <yaml-cpp/yaml.h>
+
+#include "internal/distributed.h"
+#include "internal/exceptions.h"
+#include "internal/normalization.h"
+#include "internal/param_map.h"
+#include "internal/setup.h"
+
+namespace torchfort {
+
+RunningStats::RunningStats(bool per_channel, double eps, torch::Device device)
+    : per_channel_(per_channel), device_(device), eps_(eps) {}
+
+torch::Tensor RunningStats::flatten(const torch::Tensor& x) const {
+  if (per_channel_) {
+    // [batch, channels, ...] -> [batch * ..., channels]
+    return x.transpose(0, 1).reshape({x.size(1), -1}).t();
+  }
+  return x.reshape({x.size(0), -1});
+}
+
+void RunningStats::update(const torch::Tensor& x) {
+  torch::NoGradGuard no_grad;
+
+  if (per_channel_ && x.dim() < 2) {
+    THROW_INVALID_USAGE("Per-channel normalization requires samples with a channel dimension.");
+  }
+
+  auto samples = flatten(x).to(device_, torch::kFloat64);
+  if (!pending_mean_.defined()) {
+    if (per_channel_) {
+      view_shape_.assign(x.dim() - 1, 1);
+      view_shape_[0] = x.size(1);
+    } else {
+      view_shape_ = x.sizes().slice(1).vec();
+    }
+    pending_mean_ = torch::zeros({samples.size(1)}, samples.options());
+    pending_m2_ = torch::zeros({samples.size(1)}, samples.options());
+  }
+
+  // merge batch statistics into the pending statistics (Chan et al.)
+  double n_b = samples.size(0);
+  auto mean_b = samples.mean(0);
+  auto m2_b = (samples - mean_b).square().sum(0);
+  double n = pending_count_ + n_b;
+  auto delta = mean_b - pending_mean_;
+  pending_mean_ += delta * (n_b / n);
+  pending_m2_ += m2_b + delta.square() * (pending_count_ * n_b / n);
+  pending_count_ = n;
+}
+
+void RunningStats::sync(const std::shared_ptr<Comm>& comm) {
+  torch::NoGradGuard no_grad;
+
+  if (!pending_mean_.defined()) {
+    return;
+  }
+  if (!mean_.defined()) {
+    mean_ = torch::zeros_like(pending_mean_);
+    m2_ = torch::zeros_like(pending_m2_);
+  }
+
+  double n_p = pending_count_;
+  auto mean_p = pending_mean_;
+  auto m2_p = pending_m2_;
+  if (comm) {
+    // pending statistics are taken relative to the shared mean, which keeps the merge across ranks
+    // numerically stable with a single allreduce of (count, count * offset, m2 + count * offset^2)
+    auto offset = pending_mean_ - mean_;
+    auto packed = torch::cat({torch::full({1}, pending_count_, offset.options()), offset * pending_count_,
+                              pending_m2_ + offset.square() * pending_count_});
+    comm->allreduce(packed, false);
+
+    int64_t n_features = offset.numel();
+    n_p = packed[0].item<double>();
+    if (n_p > 0) {
+      auto total_offset = packed.slice(0, 1, 1 + n_features) / n_p;
+      mean_p = mean_ + total_offset;
+      m2_p = packed.slice(0, 1 + n_features) - total_offset.square() * n_p;
+    }
+  }
+
+  if (n_p > 0) {
+    double n = count_ + n_p;
+    auto delta = mean_p - mean_;
+    mean_ = mean_ + delta * (n_p / n);
+    m2_ = m2_ + m2_p + delta.square() * (count_ * n_p / n);
+    count_ = n;
+    updateTransform();
+  }
+
+  pending_count_ = 0;
+  pending_mean_.zero_();
+  pending_m2_.zero_();
+}
+
+void RunningStats::updateTransform() {
+  auto stddev = (m2_ / count_ + eps_).sqrt();
+  stddev_ = stddev.to(torch::kFloat32).view(view_shape_);
+  mean_view_ = mean_.to(torch::kFloat32).view(view_shape_);
+  scale_ = stddev.reciprocal().to(torch::kFloat32).view(view_shape_);
+  shift_ = (-mean_ / stddev).to(torch::kFloat32).view(view_shape_);
+}
+
+void RunningStats::save(torch::serialize::OutputArchive& archive, const std::string& prefix) const {
+  archive.write(prefix + "count", torch::IValue(count_));
+  archive.write(prefix + "mean", mean_.cpu());
+  archive.write(prefix + "m2", m2_.cpu());
+  archive.write(prefix + "view_shape", torch::tensor(view_shape_, torch::kInt64));
+}
+
+void RunningStats::load(torch::serialize::InputArchive& archive, const std::string& prefix) {
+  torch::IValue count;
+  torch::Tensor mean, m2, view_shape;
+  if (!archive.try_read(prefix + "count", count) || !archive.try_read(prefix + "mean", mean) ||
+      !archive.try_read(prefix + "m2", m2) || !archive.try_read(prefix + "view_shape", view_shape)) {
+    THROW_INVALID_USAGE("Normalization statistics are missing required data.");
+  }
+
+  count_ = count.to<double>();
+  mean_ = mean.to(device_);
+  m2_ = m2.to(device_);
+  auto view_shape_ptr = view_shape.data_ptr<int64_t>();
+  view_shape_.assign(view_shape_ptr, view_shape_ptr + view_shape.numel());
+  pending_count_ = 0;
+  pending_mean_ = torch::zeros_like(mean_);
+  pending_m2_ = torch::zeros_like(m2_);
+  updateTransform();
+}
+
+Normalizer::Normalizer(bool normalize_inputs, bool normalize_labels, bool per_channel, double eps,
+                       int64_t sync_frequency, torch::Device device)
+    : sync_frequency_(sync_frequency) {
+  if (normalize_inputs) {
+    input_stats_ = std::make_unique<RunningStats>(per_channel, eps, device);
+  }
+  if (normalize_labels) {
+    label_stats_ = std::make_unique<RunningStats>(per_channel, eps, device);
+  }
+}
+
+void Normalizer::update(const torch::Tensor& inputs, const torch::Tensor& labels, const std::shared_ptr<Comm>& comm) {
+  if (input_stats_) {
+    input_stats_->update(inputs);
+  }
+  if (label_stats_) {
+    label_stats_->update(labels);
+  }
+  n_updates_++;
+
+  // the first batch is merged right away, so all ranks normalize with the same statistics from the start
+  if (!comm || n_updates_ == 1 || sync_frequency_ <= 1 || n_updates_ % sync_frequency_ == 0) {
+    if (input_stats_) {
+      input_stats_->sync(comm);
+    }
+    if (label_stats_) {
+      label_stats_->sync(comm);
+    }
+  }
+}
+
+torch::Tensor Normalizer::normalizeInputs(const torch::Tensor& inputs) const {
+  if (!input_stats_ || input_stats_->empty()) {
+    return inputs;
+  }
+  return torch::addcmul(input_stats_->shift().to(inputs.dtype()), inputs, input_stats_->scale().to(inputs.dtype()));
+}
+
+torch::Tensor Normalizer::normalizeLabels(const torch::Tensor& labels) const {
+  if (!label_stats_ || label_stats_->empty()) {
+    return labels;
+  }
+  return torch::addcmul(label_stats_->shift().to(labels.dtype()), labels, label_stats_->scale().to(labels.dtype()));
+}
+
+void Normalizer::denormalizeOutput(const torch::Tensor& output, torch::Tensor& out, bool variance) const {
+  auto result = output.reshape(out.sizes());
+  if (!label_stats_ || label_stats_->empty()) {
+    out.copy_(result);
+    return;
+  }
+
+  auto stddev = label_stats_->stddev().to(result.dtype());
+  auto mean = label_stats_->mean().to(result.dtype());
+  if (out.device() == result.device()) {
+    // de-normalize straight into the output buffer
+    if (variance) {
+      torch::mul_out(out, result, stddev.square());
+    } else {
+      torch::addcmul_out(out, mean, result, stddev);
+    }
+  } else {
+    out.copy_(variance ? result * stddev.square() : torch::addcmul(mean, result, stddev));
+  }
+}
+
+void Normalizer::save(const std::string& fname) const {
+  torch::serialize::OutputArchive archive;
+  if (input_stats_ && !input_stats_->empty()) {
+    input_stats_->save(archive, "input_");
+  }
+  if (label_stats_ && !label_stats_->empty()) {
+    label_stats_->save(archive, "label_");
+  }
+  archive.save_to(fname);
+}
+
+void Normalizer::load(const std::string& fname) {
+  torch::serialize::InputArchive archive;
+  archive.load_from(fname);
+  torch::IValue ivalue;
+  if (input_stats_ && archive.try_read("input_count", ivalue)) {
+    input_stats_->load(archive, "input_");
+  }
+  if (label_stats_ && archive.try_read("label_count", ivalue)) {
+    label_stats_->load(archive, "label_");
+  }
+}
+
+std::shared_ptr<Normalizer> get_normalizer(const YAML::Node& normalization_node, torch::Device device,
+                                           int64_t default_sync_frequency) {
+  auto params = get_params(normalization_node);
+  std::set<std::string> supported_params{"inputs", "labels", "per_channel", "epsilon", "sync_frequency"};
+  check_params(supported_params, params.keys());
+
+  bool normalize_inputs = params.get_param<bool>("inputs", true)[0];
+  bool normalize_labels = params.get_param<bool>("labels", true)[0];
+  bool per_channel = params.get_param<bool>("per_channel", false)[0];
+  double eps = params.get_param<double>("epsilon", 1e-8)[0];
+  int64_t sync_frequency = params.get_param<int>("sync_frequency", static_cast<int>(default_sync_frequency))[0];
+
+  return std::make_shared<Normalizer>(normalize_inputs, normalize_labels, per_channel, eps, sync_frequency, device);
+}
+
+} // namespace torchfort
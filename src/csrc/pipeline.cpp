@@ -0,0 +1,391 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2023 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <ATen/cuda/CUDAEvent.h>
+#include <c10/cuda/CUDAGuard.h>
+#include <c10/cuda/CUDAStream.h>
+#include <torch/torch.h>
+#include <yaml-cpp/yaml.h>
+
+#include "internal/exceptions.h"
+#include "internal/model_pack.h"
+#include "internal/param_map.h"
+#include "internal/pipeline.h"
+#include "internal/setup.h"
+#include "internal/training.h"
+
+namespace torchfort {
+
+Pipeline::Pipeline(std::vector<Stage> stages, TensorRef output, int micro_batches)
+    : stages_(std::move(stages)), output_(output), micro_batches_(micro_batches) {
+  if (micro_batches_ > 1) {
+    queues_.resize(stages_.size());
+    for (int s = 0; s < stages_.size(); ++s) {
+      threads_.emplace_back(&Pipeline::worker, this, s);
+    }
+  }
+}
+
+Pipeline::~Pipeline() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  queue_cv_.notify_all();
+  for (auto& thread : threads_) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+}
+
+std::vector<std::string> Pipeline::models() const {
+  std::vector<std::string> names;
+  for (const auto& stage : stages_) {
+    if (std::find(names.begin(), names.end(), stage.model) == names.end()) {
+      names.push_back(stage.model);
+    }
+  }
+  return names;
+}
+
+std::vector<torch::Tensor> Pipeline::forwardStage(int s, const torch::Tensor& input,
+                                                  const std::vector<std::vector<torch::Tensor>>& outputs) const {
+  const auto& stage = stages_[s];
+  const auto& model_pack = *stage.model_pack;
+  auto model = model_pack.model.get();
+
+  std::vector<torch::Tensor> inputs;
+  for (const auto& [src, idx] : stage.inputs) {
+    if (src < 0) {
+      inputs.push_back(input.to(model->device()));
+      continue;
+    }
+    if (idx >= outputs[src].size()) {
+      THROW_INVALID_USAGE("Pipeline stage " + stage.name + " references output " + std::to_string(idx) + " of stage " +
+                          stages_[src].name + ", which returns " + std::to_string(outputs[src].size()) + " outputs.");
+    }
+    inputs.push_back(outputs[src][idx].to(model->device()));
+  }
+
+  auto normalizer = model_pack.normalizer.get();
+  if (normalizer) {
+    inputs[0] = normalizer->normalizeInputs(inputs[0]);
+  }
+
+  auto results = model->forward(inputs);
+
+  // reduce over ensemble members stacked along the leading dimension
+  bool variance = false;
+  if (model->ensemble_size() > 1) {
+    switch (model_pack.state->ensemble_output) {
+    case TORCHFORT_ENSEMBLE_MEAN:
+      results[0] = results[0].mean(0);
+      break;
+    case TORCHFORT_ENSEMBLE_VARIANCE:
+      results[0] = results[0].var(0, /*unbiased=*/false);
+      variance = true;
+      break;
+    case TORCHFORT_ENSEMBLE_ALL:
+      break;
+    }
+  }
+
+  if (normalizer) {
+    auto output = torch::empty_like(results[0]);
+    normalizer->denormalizeOutput(results[0], output, variance);
+    results[0] = output;
+  }
+  return results;
+}
+
+void Pipeline::run(const torch::Tensor& input, torch::Tensor& out) {
+  for (const auto& stage : stages_) {
+    stage.model_pack->model->eval();
+  }
+
+  if (micro_batches_ > 1 && input.size(0) > 1) {
+    runMicroBatched(input, out);
+    return;
+  }
+
+  std::vector<std::vector<torch::Tensor>> outputs(stages_.size());
+  for (int s = 0; s < stages_.size(); ++s) {
+    outputs[s] = forwardStage(s, input, outputs);
+  }
+  const auto& [stage, idx] = output_;
+  if (idx >= outputs[stage].size()) {
+    THROW_INVALID_USAGE("Pipeline output references output " + std::to_string(idx) + " of stage " +
+                        stages_[stage].name + ", which returns " + std::to_string(outputs[stage].size()) + " outputs.");
+  }
+  out.copy_(outputs[stage][idx].reshape(out.sizes()));
+}
+
+void Pipeline::runMicroBatched(const torch::Tensor& input, torch::Tensor& out) {
+  if (out.size(0) != input.size(0)) {
+    THROW_INVALID_USAGE("Pipelines with micro_batches > 1 require matching input and output batch sizes.");
+  }
+
+  input_chunks_ = input.chunk(micro_batches_, 0);
+  int n_micro = input_chunks_.size();
+  outputs_.assign(n_micro, std::vector<std::vector<torch::Tensor>>(stages_.size()));
+  events_.assign(n_micro, std::vector<std::shared_ptr<at::cuda::CUDAEvent>>(stages_.size()));
+  input_ready_.reset();
+  if (input.is_cuda()) {
+    input_ready_ = std::make_shared<at::cuda::CUDAEvent>();
+    input_ready_->record(c10::cuda::getCurrentCUDAStream(input.device().index()));
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    error_ = nullptr;
+    n_done_ = 0;
+    for (int m = 0; m < n_micro; ++m) {
+      queues_[0].push_back(m);
+    }
+  }
+  queue_cv_.notify_all();
+
+  std::exception_ptr error;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [&] { return n_done_ == n_micro; });
+    error = error_;
+  }
+
+  // order the calling stream after all stage work, intermediates are released at the end of the call
+  for (const auto& stage_events : events_) {
+    for (const auto& event : stage_events) {
+      if (!event) {
+        continue;
+      }
+      if (out.is_cuda()) {
+        event->block(c10::cuda::getCurrentCUDAStream(out.device().index()));
+      } else {
+        event->synchronize();
+      }
+    }
+  }
+
+  if (!error) {
+    try {
+      const auto& [stage, idx] = output_;
+      int64_t offset = 0;
+      for (int m = 0; m < n_micro; ++m) {
+        const auto& results = outputs_[m][stage];
+        if (idx >= results.size()) {
+          THROW_INVALID_USAGE("Pipeline output references output " + std::to_string(idx) + " of stage " +
+                              stages_[stage].name + ", which returns " + std::to_string(results.size()) + " outputs.");
+        }
+        auto out_chunk = out.narrow(0, offset, input_chunks_[m].size(0));
+        out_chunk.copy_(results[idx].reshape(out_chunk.sizes()));
+        offset += input_chunks_[m].size(0);
+      }
+    } catch (...) {
+      error = std::current_exception();
+    }
+  }
+
+  input_chunks_.clear();
+  outputs_.clear();
+  events_.clear();
+  input_ready_.reset();
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void Pipeline::worker(int s) {
+  // every stage runs on a dedicated stream of its model device
+  auto device = stages_[s].model_pack->model->device();
+  c10::cuda::OptionalCUDAGuard device_guard;
+  c10::cuda::OptionalCUDAStreamGuard stream_guard;
+  if (device.is_cuda()) {
+    device_guard.set_device(device);
+    stream_guard.reset_stream(c10::cuda::getStreamFromPool(/*isHighPriority=*/false, device.index()));
+  }
+  // grad mode is thread local
+  torch::NoGradGuard no_grad;
+
+  while (true) {
+    int m;
+    bool failed;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      queue_cv_.wait(lock, [&] { return !queues_[s].empty() || stop_; });
+      if (stop_) {
+        return;
+      }
+      m = queues_[s].front();
+      queues_[s].pop_front();
+      failed = static_cast<bool>(error_);
+    }
+
+    // after an error, micro-batches are passed through without evaluation so that the caller is released
+    if (!failed) {
+      try {
+        for (const auto& [src, idx] : stages_[s].inputs) {
+          const auto& event = (src < 0) ? input_ready_ : events_[m][src];
+          if (!event) {
+            continue;
+          }
+          if (device.is_cuda()) {
+            event->block(c10::cuda::getCurrentCUDAStream(device.index()));
+          } else {
+            event->synchronize();
+          }
+        }
+        outputs_[m][s] = forwardStage(s, input_chunks_[m], outputs_[m]);
+        if (device.is_cuda()) {
+          events_[m][s] = std::make_shared<at::cuda::CUDAEvent>();
+          events_[m][s]->record(c10::cuda::getCurrentCUDAStream(device.index()));
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error_ = std::current_exception();
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (s + 1 < stages_.size()) {
+        queues_[s + 1].push_back(m);
+      } else {
+        n_done_++;
+      }
+    }
+    queue_cv_.notify_all();
+    done_cv_.notify_all();
+  }
+}
+
+std::shared_ptr<Pipeline> get_pipeline(const YAML::Node& pipeline_node) {
+  ParamMap params;
+  if (pipeline_node["parameters"]) {
+    params = get_params(pipeline_node["parameters"]);
+  }
+  std::set<std::string> supported_params{"micro_batches"};
+  check_params(supported_params, params.keys());
+
+  int micro_batches = params.get_param<int>("micro_batches", 1)[0];
+  if (micro_batches <= 0) {
+    THROW_INVALID_USAGE("pipeline micro_batches must be positive.");
+  }
+
+  auto stages_node = pipeline_node["stages"];
+  if (!stages_node || !stages_node.IsSequence() || stages_node.size() == 0) {
+    THROW_INVALID_USAGE("Missing stages list in pipeline block in configuration file.");
+  }
+
+  // references are either input, <stage> or <stage>:<output index> of an earlier stage
+  std::vector<Pipeline::Stage> stages;
+  std::unordered_map<std::string, int> stage_index;
+  auto resolve = [&](const std::string& ref) -> Pipeline::TensorRef {
+    if (ref == "input") {
+      return {-1, 0};
+    }
+    std::string key = ref;
+    int idx = 0;
+    auto pos = ref.rfind(':');
+    if (pos != std::string::npos) {
+      key = ref.substr(0, pos);
+      try {
+        idx = std::stoi(ref.substr(pos + 1));
+      } catch (const std::exception& e) {
+        idx = -1;
+      }
+      if (idx < 0) {
+        THROW_INVALID_USAGE("Invalid output index in pipeline reference " + ref + ".");
+      }
+    }
+    auto it = stage_index.find(key);
+    if (it == stage_index.end()) {
+      THROW_INVALID_USAGE("Pipeline reference " + ref + " does not name an earlier stage.");
+    }
+    return {it->second, idx};
+  };
+
+  for (const auto& stage_node : stages_node) {
+    Pipeline::Stage stage;
+    if (!stage_node["model"]) {
+      THROW_INVALID_USAGE("Missing model field in pipeline stage.");
+    }
+    stage.model = stage_node["model"].as<std::string>();
+    stage.name = stage_node["name"] ? stage_node["name"].as<std::string>() : stage.model;
+    auto it = models.find(stage.model);
+    if (it == models.end()) {
+      THROW_INVALID_USAGE("Pipeline stage " + stage.name + " references unknown model " + stage.model + ".");
+    }
+    // elements of the model map keep their address when it rehashes
+    stage.model_pack = &it->second;
+    if (stage.model_pack->recurrent_state) {
+      THROW_NOT_SUPPORTED("Stateful models are not supported in pipelines.");
+    }
+
+    if (stage_node["inputs"]) {
+      for (const auto& ref : stage_node["inputs"].as<std::vector<std::string>>()) {
+        stage.inputs.push_back(resolve(ref));
+      }
+    } else {
+      // by default, a stage consumes the first output of the preceding stage
+      stage.inputs.push_back(stages.empty() ? Pipeline::TensorRef{-1, 0}
+                                            : Pipeline::TensorRef{static_cast<int>(stages.size()) - 1, 0});
+    }
+    if (stage.inputs.empty()) {
+      THROW_INVALID_USAGE("Pipeline stage " + stage.name + " has no inputs.");
+    }
+
+    if (stage_index.count(stage.name)) {
+      THROW_INVALID_USAGE("Duplicate pipeline stage name " + stage.name + ", stages reusing a model require a name.");
+    }
+    stage_index[stage.name] = stages.size();
+    stages.push_back(std::move(stage));
+  }
+
+  Pipeline::TensorRef output{static_cast<int>(stages.size()) - 1, 0};
+  if (pipeline_node["output"]) {
+    output = resolve(pipeline_node["output"].as<std::string>());
+    if (output.first < 0) {
+      THROW_INVALID_USAGE("Pipeline output must reference a stage.");
+    }
+  }
+
+  return std::make_shared<Pipeline>(std::move(stages), output, micro_batches);
+}
+
+} // namespace torchfort
@@ -33,6 +33,7 @@
 
 #include "internal/exceptions.h"
 #include "internal/rl/off_policy/ddpg.h"
+#include "internal/rl/policy.h"
 #include "torchfort.h"
 
 namespace torchfort {
@@ -49,11 +50,20 @@ DDPGSystem::DDPGSystem(const char* name, const YAML::Node& system_node,
   auto algo_node = system_node["algorithm"];
   if (algo_node["parameters"]) {
     auto params = get_params(algo_node["parameters"]);
-    std::set<std::string> supported_params{"batch_size", "nstep", "nstep_reward_reduction", "gamma", "rho"};
+    std::set<std::string> supported_params{"batch_size", "nstep", "nstep_reward_reduction", "gamma",
+                                           "rho", "replay_ratio", "update_granularity", "policy_sync_interval",
+                                           "num_learners"};
     check_params(supported_params, params.keys());
     batch_size_ = params.get_param<int>("batch_size")[0];
     gamma_ = params.get_param<float>("gamma")[0];
     rho_ = params.get_param<float>("rho")[0];
+    replay_ratio_ = params.get_param<float>("replay_ratio", 0.)[0];
+    update_granularity_ = params.get_param<int>("update_granularity", 1)[0];
+    if ((replay_ratio_ < 0.) || (update_granularity_ < 1)) {
+      THROW_INVALID_USAGE("replay_ratio has to be non-negative and update_granularity positive.");
+    }
+    policy_sync_interval_ = params.get_param<int>("policy_sync_interval", 0)[0];
+    num_learners_ = params.get_param<int>("num_learners", 1)[0];
     nstep_ = params.get_param<int>("nstep", 1)[0];
     auto redmode = params.get_param<std::string>("nstep_reward_reduction", "sum")[0];
     if (redmode == "sum") {
@@ -80,8 +90,8 @@ DDPGSystem::DDPGSystem(const char* name, const YAML::Node& system_node,
     std::string noise_actor_type = sanitize(actor_node["type"].as<std::string>());
     if (actor_node["parameters"]) {
       auto params = get_params(actor_node["parameters"]);
-      std::set<std::string> supported_params{"a_low", "a_high", "clip",     "sigma_train",     "sigma_explore",
-                                             "xi",    "dt",     "adaptive", "noise_actor_type"};
+      std::set<std::string> supported_params{"a_low", "a_high",   "clip",     "sigma_train",     "sigma_explore",
+                                             "xi",    "dt",       "adaptive", "noise_actor_type", "max_envs"};
       check_params(supported_params, params.keys());
       a_low_ = params.get_param<float>("a_low")[0];
       a_high_ = params.get_param<float>("a_high")[0];
@@ -90,6 +100,7 @@ DDPGSystem::DDPGSystem(const char* name, const YAML::Node& system_node,
       float sigma_explore = params.get_param<float>("sigma_explore")[0];
       float mu = 0.f;
       bool adaptive = params.get_param<bool>("adaptive", false)[0];
+      int64_t max_envs = params.get_param<int>("max_envs", 0)[0];
 
       // we need to set up the noise actor type:
       if (noise_actor_type == "space_noise") {
@@ -99,7 +110,8 @@ DDPGSystem::DDPGSystem(const char* name, const YAML::Node& system_node,
         float dt = params.get_param<float>("dt")[0];
         float xi = params.get_param<float>("xi", 0.)[0];
         noise_actor_train_ = std::make_shared<ActionNoiseOU<float>>(mu, sigma_train, clip, dt, xi, adaptive);
-        noise_actor_exploration_ = std::make_shared<ActionNoiseOU<float>>(mu, sigma_explore, 0.f, dt, xi, adaptive);
+        noise_actor_exploration_ =
+            std::make_shared<ActionNoiseOU<float>>(mu, sigma_explore, 0.f, dt, xi, adaptive, max_envs);
       } else if (noise_actor_type == "parameter_noise") {
         noise_actor_train_ = std::make_shared<ParameterNoise<float>>(mu, sigma_train, clip, adaptive);
         noise_actor_exploration_ = std::make_shared<ParameterNoise<float>>(mu, sigma_explore, 0.f, adaptive);
@@ -124,6 +136,9 @@ DDPGSystem::DDPGSystem(const char* name, const YAML::Node& system_node,
     if (rb_node["parameters"]) {
       auto params = get_params(rb_node["parameters"]);
       std::set<std::string> supported_params{"type", "max_size", "min_size"};
+      if (rb_type == "tiered") {
+        supported_params.insert({"hot_size", "path"});
+      }
       check_params(supported_params, params.keys());
       auto max_size = static_cast<size_t>(params.get_param<int>("max_size")[0]);
       auto min_size = static_cast<size_t>(params.get_param<int>("min_size")[0]);
@@ -131,6 +146,11 @@ DDPGSystem::DDPGSystem(const char* name, const YAML::Node& system_node,
       // distinction between buffer types
       if (rb_type == "uniform") {
         replay_buffer_ = std::make_shared<UniformReplayBuffer>(max_size, min_size, gamma_, nstep_, nstep_reward_reduction_, rb_device);
+      } else if (rb_type == "tiered") {
+        auto hot_size = static_cast<size_t>(params.get_param<int>("hot_size")[0]);
+        auto path = params.get_param<std::string>("path", "")[0];
+        replay_buffer_ = std::make_shared<TieredReplayBuffer>(max_size, min_size, hot_size, path, gamma_, nstep_,
+                                                              nstep_reward_reduction_, rb_device);
       } else {
         THROW_INVALID_USAGE(rb_type);
       }
@@ -243,19 +263,22 @@ torch::Device DDPGSystem::rbDevice() const {
 }
 
 void DDPGSystem::initSystemComm(MPI_Comm mpi_comm) {
+  // actor-only ranks of policy replication are split off from the learners
+  auto train_comm = initPolicySync_(mpi_comm);
+
   // Set up distributed communicators for all models
   // system
-  system_comm_ = std::make_shared<Comm>(mpi_comm);
+  system_comm_ = std::make_shared<Comm>(train_comm);
   system_comm_->initialize(model_device_.is_cuda());
   // policy
-  p_model_.comm = std::make_shared<Comm>(mpi_comm);
+  p_model_.comm = std::make_shared<Comm>(train_comm);
   p_model_.comm->initialize(model_device_.is_cuda());
-  p_model_target_.comm = std::make_shared<Comm>(mpi_comm);
+  p_model_target_.comm = std::make_shared<Comm>(train_comm);
   p_model_target_.comm->initialize(model_device_.is_cuda());
   // critic
-  q_model_.comm = std::make_shared<Comm>(mpi_comm);
+  q_model_.comm = std::make_shared<Comm>(train_comm);
   q_model_.comm->initialize(model_device_.is_cuda());
-  q_model_target_.comm = std::make_shared<Comm>(mpi_comm);
+  q_model_target_.comm = std::make_shared<Comm>(train_comm);
   q_model_target_.comm->initialize(model_device_.is_cuda());
 
   // move to device before broadcasting
@@ -281,9 +304,22 @@ void DDPGSystem::initSystemComm(MPI_Comm mpi_comm) {
   for (auto& p : q_model_target_.model->parameters()) {
     q_model_target_.comm->broadcast(p, 0);
   }
+
+  // actor-only ranks start from the initial policy of the learners
+  if (policy_sync_) {
+    policy_sync_->initialize(p_model_.model->parameters());
+    if (!policy_sync_->learner()) {
+      copy_parameters(p_model_target_.model, p_model_.model);
+    }
+  }
 }
 
 // Save checkpoint
+void DDPGSystem::exportPolicy(const std::string& fname) const {
+  // deterministic actions are predicted with the target policy and clipped
+  export_policy(fname, p_model_target_.model, /* squashed = */ false, ActorNormalizationMode::Clip, a_low_, a_high_);
+}
+
 void DDPGSystem::saveCheckpoint(const std::string& checkpoint_dir) const {
   using namespace torchfort;
   std::filesystem::path root_dir(checkpoint_dir);
@@ -360,12 +396,26 @@ void DDPGSystem::updateReplayBuffer(torch::Tensor s, torch::Tensor a, torch::Ten
   replay_buffer_->update(s, a, sp, r, d);
 }
 
+void DDPGSystem::updateReplayBufferMultiAgent(torch::Tensor s, torch::Tensor a, torch::Tensor sp, torch::Tensor r,
+                                              bool d) {
+  replay_buffer_->updateMultiAgent(s, a, sp, r, d);
+}
+
 bool DDPGSystem::isReady() { return (replay_buffer_->isReady()); }
 
+void DDPGSystem::resetExplorationNoise(int64_t env_id) { noise_actor_exploration_->resetNoise(env_id); }
+
 std::shared_ptr<ModelState> DDPGSystem::getSystemState_() { return system_state_; }
 
 std::shared_ptr<Comm> DDPGSystem::getSystemComm_() { return system_comm_; }
 
+void DDPGSystem::receivePolicy_() {
+  // swap in the latest policy received from the learners, actors also predict with it
+  if (policy_sync_ && !policy_sync_->learner() && policy_sync_->sync(p_model_.model->parameters())) {
+    copy_parameters(p_model_target_.model, p_model_.model);
+  }
+}
+
 torch::Tensor DDPGSystem::predictWithNoiseTrain_(torch::Tensor state) {
   // no grad guard
   torch::NoGradGuard no_grad;
@@ -378,8 +428,8 @@ torch::Tensor DDPGSystem::predictWithNoiseTrain_(torch::Tensor state) {
   // get noisy prediction
   auto action = (*noise_actor_train_)(p_model_target_, state);
 
-  // clip action
-  action = torch::clamp(action, a_low_, a_high_);
+  // clip action in place, the noisy prediction is a fresh tensor
+  action.clamp_(a_low_, a_high_);
   return action;
 }
 
@@ -399,6 +449,9 @@ torch::Tensor DDPGSystem::predict(torch::Tensor state) {
   // no grad guard
   torch::NoGradGuard no_grad;
 
+  // actor-only ranks act with the replicated policy
+  receivePolicy_();
+
   // prepare inputs
   p_model_target_.model->to(model_device_);
   p_model_target_.model->eval();
@@ -417,6 +470,9 @@ torch::Tensor DDPGSystem::predictExplore(torch::Tensor state) {
   // no grad guard
   torch::NoGradGuard no_grad;
 
+  // actor-only ranks act with the replicated policy
+  receivePolicy_();
+
   // prepare inputs
   p_model_.model->to(model_device_);
   p_model_.model->eval();
@@ -473,6 +529,11 @@ void DDPGSystem::trainStep(float& p_loss_val, float& q_loss_val) {
   // train step
   train_ddpg(p_model_, p_model_target_, q_model_, q_model_target_, s, sp, a, ap, r, d,
              static_cast<float>(std::pow(gamma_, nstep_)), rho_, p_loss_val, q_loss_val);
+
+  // publish the policy to actor-only ranks every policy_sync_interval train steps
+  if (policy_sync_) {
+    policy_sync_->sync(p_model_.model->parameters());
+  }
 }
 
 } // off_policy
@@ -60,12 +60,72 @@ namespace off_policy {
 std::unordered_map<std::string, std::shared_ptr<RLOffPolicySystem>> registry;
 
 // default constructor:
-RLOffPolicySystem::RLOffPolicySystem(int model_device, int rb_device) : train_step_count_(0), model_device_(get_device(model_device)), rb_device_(get_device(rb_device)) {
+RLOffPolicySystem::RLOffPolicySystem(int model_device, int rb_device)
+    : train_step_count_(0), model_device_(get_device(model_device)), rb_device_(get_device(rb_device)),
+      replay_ratio_(0.), update_granularity_(1), update_credit_(0.), policy_sync_interval_(0), num_learners_(1) {
   if ( !(torchfort::rl::validate_devices(model_device, rb_device)) ) {
     THROW_INVALID_USAGE("The parameters model_device and rb_device have to specify the same GPU or one has to specify a GPU and the other the CPU.");
   }
 }
 
+void RLOffPolicySystem::trackEpisodes(const char* name, torch::Tensor r, bool d) {
+  auto state = getSystemState_();
+  if (!state->track_episodes) {
+    return;
+  }
+  episode_stats_.update(r, d);
+  episode_stats_.report(name, state, getSystemComm_());
+}
+
+void RLOffPolicySystem::scheduleUpdates(int64_t n_transitions) {
+  if ((replay_ratio_ <= 0.) || !isLearner()) {
+    return;
+  }
+  // credit only accumulates once the replay buffer is ready, like a manual training loop gated by is_ready
+  int64_t n_updates = 0;
+  if (isReady()) {
+    update_credit_ += static_cast<double>(replay_ratio_) * n_transitions;
+    if (update_credit_ >= update_granularity_) {
+      n_updates = static_cast<int64_t>(update_credit_);
+    }
+  }
+
+  // train steps are collective, all learners execute the number of steps every one of them owes
+  auto comm = getSystemComm_();
+  if (comm) {
+    CHECK_MPI(MPI_Allreduce(MPI_IN_PLACE, &n_updates, 1, MPI_INT64_T, MPI_MIN, comm->mpi_comm));
+  }
+  if (n_updates == 0) {
+    return;
+  }
+
+  // execute all owed updates in bulk, the remainder is carried over
+  update_credit_ -= static_cast<double>(n_updates);
+  float p_loss_val, q_loss_val;
+  for (int64_t i = 0; i < n_updates; ++i) {
+    trainStep(p_loss_val, q_loss_val);
+  }
+}
+
+MPI_Comm RLOffPolicySystem::initPolicySync_(MPI_Comm mpi_comm) {
+  if (policy_sync_interval_ <= 0) {
+    return mpi_comm;
+  }
+  int size;
+  CHECK_MPI(MPI_Comm_size(mpi_comm, &size));
+  if ((num_learners_ < 1) || (num_learners_ >= size)) {
+    THROW_INVALID_USAGE("num_learners has to be positive and smaller than the number of ranks for policy replication.");
+  }
+  policy_sync_ = std::make_shared<PolicySync>(mpi_comm, policy_sync_interval_, num_learners_);
+  return policy_sync_->trainComm();
+}
+
+void RLOffPolicySystem::stopPolicySync() {
+  if (policy_sync_) {
+    policy_sync_->stop();
+  }
+}
+
 } // namespace off_policy
 
 } // namespace rl
@@ -146,6 +206,19 @@ torchfort_result_t torchfort_rl_off_policy_load_checkpoint(const char* name, con
   return TORCHFORT_RESULT_SUCCESS;
 }
 
+// export policy
+torchfort_result_t torchfort_rl_off_policy_export_policy(const char* name, const char* fname) {
+  using namespace torchfort;
+
+  try {
+    rl::off_policy::registry[name]->exportPolicy(fname);
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
 // ready check
 torchfort_result_t torchfort_rl_off_policy_is_ready(const char* name, bool& ready) {
   using namespace torchfort;
@@ -158,6 +231,37 @@ torchfort_result_t torchfort_rl_off_policy_is_ready(const char* name, bool& read
   return TORCHFORT_RESULT_SUCCESS;
 }
 
+// reset exploration noise
+torchfort_result_t torchfort_rl_off_policy_reset_exploration_noise(const char* name, int64_t env_id,
+                                                                   cudaStream_t ext_stream) {
+  using namespace torchfort;
+  try {
+    c10::cuda::OptionalCUDAStreamGuard guard;
+    auto model_device = rl::off_policy::registry[name]->modelDevice();
+    if (model_device.is_cuda()) {
+      auto stream = c10::cuda::getStreamFromExternal(ext_stream, model_device.index());
+      guard.reset_stream(stream);
+    }
+    rl::off_policy::registry[name]->resetExplorationNoise(env_id);
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
+// stop policy replication
+torchfort_result_t torchfort_rl_off_policy_stop_policy_sync(const char* name) {
+  using namespace torchfort;
+  try {
+    rl::off_policy::registry[name]->stopPolicySync();
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
 // train step
 torchfort_result_t torchfort_rl_off_policy_train_step(const char* name, float* p_loss_val, float* q_loss_val,
                                                       cudaStream_t ext_stream) {
@@ -176,8 +280,13 @@ torchfort_result_t torchfort_rl_off_policy_train_step(const char* name, float* p
   }
 
   try {
-    // perform a training step
-    rl::off_policy::registry[name]->trainStep(*p_loss_val, *q_loss_val);
+    // perform a training step, actor-only ranks do not train
+    if (rl::off_policy::registry[name]->isLearner()) {
+      rl::off_policy::registry[name]->trainStep(*p_loss_val, *q_loss_val);
+    } else {
+      *p_loss_val = 0.;
+      *q_loss_val = 0.;
+    }
   } catch (const BaseException& e) {
     std::cerr << e.what();
     return e.getResult();
@@ -263,6 +372,66 @@ torchfort_result_t torchfort_rl_off_policy_update_replay_buffer_F(const char* na
   return TORCHFORT_RESULT_SUCCESS;
 }
 
+torchfort_result_t torchfort_rl_off_policy_update_replay_buffer_multi_agent(
+    const char* name, void* state_old, void* state_new, size_t state_dim, int64_t* state_shape, void* action_old,
+    size_t action_dim, int64_t* action_shape, const void* reward, bool final_state, torchfort_datatype_t dtype,
+    cudaStream_t stream) {
+  using namespace torchfort;
+  try {
+    switch (dtype) {
+    case TORCHFORT_FLOAT:
+      rl::off_policy::update_replay_buffer_multi_agent<RowMajor>(
+          name, reinterpret_cast<float*>(state_old), reinterpret_cast<float*>(state_new), state_dim, state_shape,
+          reinterpret_cast<float*>(action_old), action_dim, action_shape, reinterpret_cast<const float*>(reward),
+          final_state, stream);
+      break;
+    case TORCHFORT_DOUBLE:
+      rl::off_policy::update_replay_buffer_multi_agent<RowMajor>(
+          name, reinterpret_cast<double*>(state_old), reinterpret_cast<double*>(state_new), state_dim, state_shape,
+          reinterpret_cast<double*>(action_old), action_dim, action_shape, reinterpret_cast<const double*>(reward),
+          final_state, stream);
+      break;
+    default:
+      THROW_INVALID_USAGE("Unknown datatype provided.");
+      break;
+    }
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
+torchfort_result_t torchfort_rl_off_policy_update_replay_buffer_multi_agent_F(
+    const char* name, void* state_old, void* state_new, size_t state_dim, int64_t* state_shape, void* action_old,
+    size_t action_dim, int64_t* action_shape, const void* reward, bool final_state, torchfort_datatype_t dtype,
+    cudaStream_t stream) {
+  using namespace torchfort;
+  try {
+    switch (dtype) {
+    case TORCHFORT_FLOAT:
+      rl::off_policy::update_replay_buffer_multi_agent<ColMajor>(
+          name, reinterpret_cast<float*>(state_old), reinterpret_cast<float*>(state_new), state_dim, state_shape,
+          reinterpret_cast<float*>(action_old), action_dim, action_shape, reinterpret_cast<const float*>(reward),
+          final_state, stream);
+      break;
+    case TORCHFORT_DOUBLE:
+      rl::off_policy::update_replay_buffer_multi_agent<ColMajor>(
+          name, reinterpret_cast<double*>(state_old), reinterpret_cast<double*>(state_new), state_dim, state_shape,
+          reinterpret_cast<double*>(action_old), action_dim, action_shape, reinterpret_cast<const double*>(reward),
+          final_state, stream);
+      break;
+    default:
+      THROW_INVALID_USAGE("Unknown datatype provided.");
+      break;
+    }
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
 torchfort_result_t torchfort_rl_off_policy_predict_explore(const char* name, void* state, size_t state_dim,
                                                            int64_t* state_shape, void* action, size_t action_dim,
                                                            int64_t* action_shape, torchfort_datatype_t dtype,
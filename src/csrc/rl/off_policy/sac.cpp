@@ -50,12 +50,20 @@ SACSystem::SACSystem(const char* name, const YAML::Node& system_node,
   if (algo_node["parameters"]) {
     auto params = get_params(algo_node["parameters"]);
     std::set<std::string> supported_params{"batch_size", "num_critics", "nstep", "nstep_reward_reduction",
-                                           "gamma",      "rho",         "alpha"};
+                                           "gamma", "rho", "alpha", "replay_ratio",
+                                           "update_granularity", "policy_sync_interval", "num_learners"};
     check_params(supported_params, params.keys());
     batch_size_ = params.get_param<int>("batch_size")[0];
     num_critics_ = params.get_param<int>("num_critics", 2)[0];
     gamma_ = params.get_param<float>("gamma")[0];
     rho_ = params.get_param<float>("rho")[0];
+    replay_ratio_ = params.get_param<float>("replay_ratio", 0.)[0];
+    update_granularity_ = params.get_param<int>("update_granularity", 1)[0];
+    if ((replay_ratio_ < 0.) || (update_granularity_ < 1)) {
+      THROW_INVALID_USAGE("replay_ratio has to be non-negative and update_granularity positive.");
+    }
+    policy_sync_interval_ = params.get_param<int>("policy_sync_interval", 0)[0];
+    num_learners_ = params.get_param<int>("num_learners", 1)[0];
     alpha_ = params.get_param<float>("rho")[0];
     nstep_ = params.get_param<int>("nstep", 1)[0];
     auto redmode = params.get_param<std::string>("nstep_reward_reduction", "sum")[0];
@@ -94,6 +102,9 @@ SACSystem::SACSystem(const char* name, const YAML::Node& system_node,
     if (rb_node["parameters"]) {
       auto params = get_params(rb_node["parameters"]);
       std::set<std::string> supported_params{"type", "max_size", "min_size"};
+      if (rb_type == "tiered") {
+        supported_params.insert({"hot_size", "path"});
+      }
       check_params(supported_params, params.keys());
       auto max_size = static_cast<size_t>(params.get_param<int>("max_size")[0]);
       auto min_size = static_cast<size_t>(params.get_param<int>("min_size")[0]);
@@ -101,6 +112,11 @@ SACSystem::SACSystem(const char* name, const YAML::Node& system_node,
       // distinction between buffer types
       if (rb_type == "uniform") {
         replay_buffer_ = std::make_shared<UniformReplayBuffer>(max_size, min_size, gamma_, nstep_, nstep_reward_reduction_, rb_device);
+      } else if (rb_type == "tiered") {
+        auto hot_size = static_cast<size_t>(params.get_param<int>("hot_size")[0]);
+        auto path = params.get_param<std::string>("path", "")[0];
+        replay_buffer_ = std::make_shared<TieredReplayBuffer>(max_size, min_size, hot_size, path, gamma_, nstep_,
+                                                              nstep_reward_reduction_, rb_device);
       } else {
         THROW_INVALID_USAGE(rb_type);
       }
@@ -214,20 +230,23 @@ torch::Device SACSystem::rbDevice() const {
 }
   
 void SACSystem::initSystemComm(MPI_Comm mpi_comm) {
+  // actor-only ranks of policy replication are split off from the learners
+  auto train_comm = initPolicySync_(mpi_comm);
+
   // Set up distributed communicators for all models
   // system
-  system_comm_ = std::make_shared<Comm>(mpi_comm);
+  system_comm_ = std::make_shared<Comm>(train_comm);
   system_comm_->initialize(model_device_.is_cuda());
   // policy
-  p_model_.comm = std::make_shared<Comm>(mpi_comm);
+  p_model_.comm = std::make_shared<Comm>(train_comm);
   p_model_.comm->initialize(model_device_.is_cuda());
   // critic
   for (auto& q_model : q_models_) {
-    q_model.comm = std::make_shared<Comm>(mpi_comm);
+    q_model.comm = std::make_shared<Comm>(train_comm);
     q_model.comm->initialize(model_device_.is_cuda());
   }
   for (auto& q_model_target : q_models_target_) {
-    q_model_target.comm = std::make_shared<Comm>(mpi_comm);
+    q_model_target.comm = std::make_shared<Comm>(train_comm);
     q_model_target.comm->initialize(model_device_.is_cuda());
   }
 
@@ -259,10 +278,21 @@ void SACSystem::initSystemComm(MPI_Comm mpi_comm) {
     }
   }
 
+  // actor-only ranks start from the initial policy of the learners
+  if (policy_sync_) {
+    policy_sync_->initialize(p_model_.model->parameters());
+  }
+
   return;
 }
 
 // Save checkpoint
+void SACSystem::exportPolicy(const std::string& fname) const {
+  // the policy predicts squashed actions in [-1, 1]
+  export_policy(fname, p_model_.model->network(), p_model_.model->squashed(), ActorNormalizationMode::Scale, a_low_,
+                a_high_);
+}
+
 void SACSystem::saveCheckpoint(const std::string& checkpoint_dir) const {
   using namespace torchfort;
   std::filesystem::path root_dir(checkpoint_dir);
@@ -399,12 +429,28 @@ void SACSystem::updateReplayBuffer(torch::Tensor s, torch::Tensor a, torch::Tens
   replay_buffer_->update(s, as, sp, r, d);
 }
 
+void SACSystem::updateReplayBufferMultiAgent(torch::Tensor s, torch::Tensor a, torch::Tensor sp, torch::Tensor r,
+                                             bool d) {
+  // note that we have to rescale the action: [a_low, a_high] -> [-1, 1]
+  auto as = scale_action(a, a_low_, a_high_);
+
+  // the replay buffer only stores scaled actions!
+  replay_buffer_->updateMultiAgent(s, as, sp, r, d);
+}
+
 bool SACSystem::isReady() { return (replay_buffer_->isReady()); }
 
 std::shared_ptr<ModelState> SACSystem::getSystemState_() { return system_state_; }
 
 std::shared_ptr<Comm> SACSystem::getSystemComm_() { return system_comm_; }
 
+void SACSystem::receivePolicy_() {
+  // swap in the latest policy received from the learners
+  if (policy_sync_ && !policy_sync_->learner()) {
+    policy_sync_->sync(p_model_.model->parameters());
+  }
+}
+
 // do exploration step without knowledge about the state
 // for example, apply random action
 torch::Tensor SACSystem::explore(torch::Tensor action) {
@@ -421,6 +467,9 @@ torch::Tensor SACSystem::predict(torch::Tensor state) {
   // no grad guard
   torch::NoGradGuard no_grad;
 
+  // actor-only ranks act with the replicated policy
+  receivePolicy_();
+
   // prepare inputs
   p_model_.model->to(model_device_);
   p_model_.model->eval();
@@ -439,6 +488,9 @@ torch::Tensor SACSystem::predictExplore(torch::Tensor state) {
   // no grad guard
   torch::NoGradGuard no_grad;
 
+  // actor-only ranks act with the replicated policy
+  receivePolicy_();
+
   // prepare inputs
   p_model_.model->to(model_device_);
   p_model_.model->eval();
@@ -501,6 +553,11 @@ void SACSystem::trainStep(float& p_loss_val, float& q_loss_val) {
   // compute average of q_loss_vals:
   q_loss_val = std::accumulate(q_loss_vals.begin(), q_loss_vals.end(), decltype(q_loss_vals)::value_type(0)) /
                float(q_loss_vals.size());
+
+  // publish the policy to actor-only ranks every policy_sync_interval train steps
+  if (policy_sync_) {
+    policy_sync_->sync(p_model_.model->parameters());
+  }
 }
 
 } // namespace off_policy
@@ -33,6 +33,7 @@
 
 #include "internal/exceptions.h"
 #include "internal/rl/off_policy/td3.h"
+#include "internal/rl/policy.h"
 
 namespace torchfort {
   
@@ -48,14 +49,22 @@ TD3System::TD3System(const char* name, const YAML::Node& system_node,
   auto algo_node = system_node["algorithm"];
   if (algo_node["parameters"]) {
     auto params = get_params(algo_node["parameters"]);
-    std::set<std::string> supported_params{"batch_size", "num_critics", "policy_lag", "nstep", "nstep_reward_reduction",
-                                           "gamma", "rho"};
+    std::set<std::string> supported_params{"batch_size", "num_critics", "policy_lag", "nstep",
+                                           "nstep_reward_reduction", "gamma", "rho", "replay_ratio",
+                                           "update_granularity", "policy_sync_interval", "num_learners"};
     check_params(supported_params, params.keys());
     batch_size_ = params.get_param<int>("batch_size")[0];
     num_critics_ = params.get_param<int>("num_critics", 2)[0];
     policy_lag_ = params.get_param<int>("policy_lag")[0];
     gamma_ = params.get_param<float>("gamma")[0];
     rho_ = params.get_param<float>("rho")[0];
+    replay_ratio_ = params.get_param<float>("replay_ratio", 0.)[0];
+    update_granularity_ = params.get_param<int>("update_granularity", 1)[0];
+    if ((replay_ratio_ < 0.) || (update_granularity_ < 1)) {
+      THROW_INVALID_USAGE("replay_ratio has to be non-negative and update_granularity positive.");
+    }
+    policy_sync_interval_ = params.get_param<int>("policy_sync_interval", 0)[0];
+    num_learners_ = params.get_param<int>("num_learners", 1)[0];
     nstep_ = params.get_param<int>("nstep", 1)[0];
     auto redmode = params.get_param<std::string>("nstep_reward_reduction", "sum")[0];
     if (redmode == "sum") {
@@ -82,8 +91,8 @@ TD3System::TD3System(const char* name, const YAML::Node& system_node,
     std::string noise_actor_type = sanitize(actor_node["type"].as<std::string>());
     if (actor_node["parameters"]) {
       auto params = get_params(actor_node["parameters"]);
-      std::set<std::string> supported_params{"a_low", "a_high", "clip",     "sigma_train",     "sigma_explore",
-                                             "xi",    "dt",     "adaptive", "noise_actor_type"};
+      std::set<std::string> supported_params{"a_low", "a_high",   "clip",     "sigma_train",     "sigma_explore",
+                                             "xi",    "dt",       "adaptive", "noise_actor_type", "max_envs"};
       check_params(supported_params, params.keys());
       a_low_ = params.get_param<float>("a_low")[0];
       a_high_ = params.get_param<float>("a_high")[0];
@@ -92,6 +101,7 @@ TD3System::TD3System(const char* name, const YAML::Node& system_node,
       float sigma_explore = params.get_param<float>("sigma_explore")[0];
       float mu = 0.f;
       bool adaptive = params.get_param<bool>("adaptive", false)[0];
+      int64_t max_envs = params.get_param<int>("max_envs", 0)[0];
 
       // we need to set up the noise actor type:
       if (noise_actor_type == "space_noise") {
@@ -101,7 +111,8 @@ TD3System::TD3System(const char* name, const YAML::Node& system_node,
         float dt = params.get_param<float>("dt")[0];
         float xi = params.get_param<float>("xi", 0.)[0];
         noise_actor_train_ = std::make_shared<ActionNoiseOU<float>>(mu, sigma_train, clip, dt, xi, adaptive);
-        noise_actor_exploration_ = std::make_shared<ActionNoiseOU<float>>(mu, sigma_explore, 0.f, dt, xi, adaptive);
+        noise_actor_exploration_ =
+            std::make_shared<ActionNoiseOU<float>>(mu, sigma_explore, 0.f, dt, xi, adaptive, max_envs);
       } else if (noise_actor_type == "parameter_noise") {
         noise_actor_train_ = std::make_shared<ParameterNoise<float>>(mu, sigma_train, clip, adaptive);
         noise_actor_exploration_ = std::make_shared<ParameterNoise<float>>(mu, sigma_explore, 0.f, adaptive);
@@ -126,6 +137,9 @@ TD3System::TD3System(const char* name, const YAML::Node& system_node,
     if (rb_node["parameters"]) {
       auto params = get_params(rb_node["parameters"]);
       std::set<std::string> supported_params{"type", "max_size", "min_size"};
+      if (rb_type == "tiered") {
+        supported_params.insert({"hot_size", "path"});
+      }
       check_params(supported_params, params.keys());
       auto max_size = static_cast<size_t>(params.get_param<int>("max_size")[0]);
       auto min_size = static_cast<size_t>(params.get_param<int>("min_size")[0]);
@@ -133,6 +147,11 @@ TD3System::TD3System(const char* name, const YAML::Node& system_node,
       // distinction between buffer types
       if (rb_type == "uniform") {
         replay_buffer_ = std::make_shared<UniformReplayBuffer>(max_size, min_size, gamma_, nstep_, nstep_reward_reduction_, rb_device);
+      } else if (rb_type == "tiered") {
+        auto hot_size = static_cast<size_t>(params.get_param<int>("hot_size")[0]);
+        auto path = params.get_param<std::string>("path", "")[0];
+        replay_buffer_ = std::make_shared<TieredReplayBuffer>(max_size, min_size, hot_size, path, gamma_, nstep_,
+                                                              nstep_reward_reduction_, rb_device);
       } else {
         THROW_INVALID_USAGE(rb_type);
       }
@@ -257,22 +276,25 @@ torch::Device TD3System::rbDevice() const {
 }
   
 void TD3System::initSystemComm(MPI_Comm mpi_comm) {
+  // actor-only ranks of policy replication are split off from the learners
+  auto train_comm = initPolicySync_(mpi_comm);
+
   // Set up distributed communicators for all models
   // system
-  system_comm_ = std::make_shared<Comm>(mpi_comm);
+  system_comm_ = std::make_shared<Comm>(train_comm);
   system_comm_->initialize(model_device_.is_cuda());
   // policy
-  p_model_.comm = std::make_shared<Comm>(mpi_comm);
+  p_model_.comm = std::make_shared<Comm>(train_comm);
   p_model_.comm->initialize(model_device_.is_cuda());
-  p_model_target_.comm = std::make_shared<Comm>(mpi_comm);
+  p_model_target_.comm = std::make_shared<Comm>(train_comm);
   p_model_target_.comm->initialize(model_device_.is_cuda());
   // critic
   for (auto& q_model : q_models_) {
-    q_model.comm = std::make_shared<Comm>(mpi_comm);
+    q_model.comm = std::make_shared<Comm>(train_comm);
     q_model.comm->initialize(model_device_.is_cuda());
   }
   for (auto& q_model_target : q_models_target_) {
-    q_model_target.comm = std::make_shared<Comm>(mpi_comm);
+    q_model_target.comm = std::make_shared<Comm>(train_comm);
     q_model_target.comm->initialize(model_device_.is_cuda());
   }
 
@@ -308,10 +330,23 @@ void TD3System::initSystemComm(MPI_Comm mpi_comm) {
     }
   }
 
+  // actor-only ranks start from the initial policy of the learners
+  if (policy_sync_) {
+    policy_sync_->initialize(p_model_.model->parameters());
+    if (!policy_sync_->learner()) {
+      copy_parameters(p_model_target_.model, p_model_.model);
+    }
+  }
+
   return;
 }
 
 // saving checkpoints:
+void TD3System::exportPolicy(const std::string& fname) const {
+  // deterministic actions are predicted with the target policy and clipped
+  export_policy(fname, p_model_target_.model, /* squashed = */ false, ActorNormalizationMode::Clip, a_low_, a_high_);
+}
+
 void TD3System::saveCheckpoint(const std::string& checkpoint_dir) const {
   using namespace torchfort;
   std::filesystem::path root_dir(checkpoint_dir);
@@ -406,12 +441,26 @@ void TD3System::updateReplayBuffer(torch::Tensor s, torch::Tensor a, torch::Tens
   replay_buffer_->update(s, a, sp, r, d);
 }
 
+void TD3System::updateReplayBufferMultiAgent(torch::Tensor s, torch::Tensor a, torch::Tensor sp, torch::Tensor r,
+                                             bool d) {
+  replay_buffer_->updateMultiAgent(s, a, sp, r, d);
+}
+
 bool TD3System::isReady() { return (replay_buffer_->isReady()); }
 
+void TD3System::resetExplorationNoise(int64_t env_id) { noise_actor_exploration_->resetNoise(env_id); }
+
 std::shared_ptr<ModelState> TD3System::getSystemState_() { return system_state_; }
 
 std::shared_ptr<Comm> TD3System::getSystemComm_() { return system_comm_; }
 
+void TD3System::receivePolicy_() {
+  // swap in the latest policy received from the learners, actors also predict with it
+  if (policy_sync_ && !policy_sync_->learner() && policy_sync_->sync(p_model_.model->parameters())) {
+    copy_parameters(p_model_target_.model, p_model_.model);
+  }
+}
+
 torch::Tensor TD3System::predictWithNoiseTrain_(torch::Tensor state) {
   // no grad guard
   torch::NoGradGuard no_grad;
@@ -424,8 +473,8 @@ torch::Tensor TD3System::predictWithNoiseTrain_(torch::Tensor state) {
   // get noisy prediction
   auto action = (*noise_actor_train_)(p_model_target_, state);
 
-  // clip action
-  action = torch::clamp(action, a_low_, a_high_);
+  // clip action in place, the noisy prediction is a fresh tensor
+  action.clamp_(a_low_, a_high_);
   return action;
 }
 
@@ -445,6 +494,9 @@ torch::Tensor TD3System::predict(torch::Tensor state) {
   // no grad guard
   torch::NoGradGuard no_grad;
 
+  // actor-only ranks act with the replicated policy
+  receivePolicy_();
+
   // prepare inputs
   p_model_target_.model->to(model_device_);
   p_model_target_.model->eval();
@@ -463,6 +515,9 @@ torch::Tensor TD3System::predictExplore(torch::Tensor state) {
   // no grad guard
   torch::NoGradGuard no_grad;
 
+  // actor-only ranks act with the replicated policy
+  receivePolicy_();
+
   // prepare inputs
   p_model_.model->to(model_device_);
   p_model_.model->eval();
@@ -521,6 +576,11 @@ void TD3System::trainStep(float& p_loss_val, float& q_loss_val) {
   // train step
   train_td3(p_model_, p_model_target_, q_models_, q_models_target_, s, sp, a, ap, r, d,
             static_cast<float>(std::pow(gamma_, nstep_)), rho_, p_loss_val, q_loss_val, update_policy);
+
+  // publish the policy to actor-only ranks every policy_sync_interval train steps
+  if (policy_sync_) {
+    policy_sync_->sync(p_model_.model->parameters());
+  }
 }
 
 } // namespace off_policy
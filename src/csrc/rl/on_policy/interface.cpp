@@ -64,6 +64,15 @@ RLOnPolicySystem::RLOnPolicySystem(int model_device, int rb_device) : train_step
   }
 }
 
+void RLOnPolicySystem::trackEpisodes(const char* name, torch::Tensor r, bool d) {
+  auto state = getSystemState_();
+  if (!state->track_episodes) {
+    return;
+  }
+  episode_stats_.update(r, d);
+  episode_stats_.report(name, state, getSystemComm_());
+}
+
 } // namespace on_policy
 
 } // namespace rl
@@ -140,6 +149,19 @@ torchfort_result_t torchfort_rl_on_policy_load_checkpoint(const char* name, cons
   return TORCHFORT_RESULT_SUCCESS;
 }
 
+// export policy
+torchfort_result_t torchfort_rl_on_policy_export_policy(const char* name, const char* fname) {
+  using namespace torchfort;
+
+  try {
+    rl::on_policy::registry[name]->exportPolicy(fname);
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
 // ready check
 torchfort_result_t torchfort_rl_on_policy_is_ready(const char* name, bool& ready) {
   using namespace torchfort;
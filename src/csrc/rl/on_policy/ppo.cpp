@@ -201,6 +201,11 @@ void PPOSystem::initSystemComm(MPI_Comm mpi_comm) {
 }
 
 // Save checkpoint
+void PPOSystem::exportPolicy(const std::string& fname) const {
+  export_policy(fname, pq_model_.model->network(), pq_model_.model->squashed(), actor_normalization_mode_, a_low_,
+                a_high_);
+}
+
 void PPOSystem::saveCheckpoint(const std::string& checkpoint_dir) const {
   using namespace torchfort;
   std::filesystem::path root_dir(checkpoint_dir);
@@ -29,9 +29,15 @@
  */
 
 #include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+#include <torch/script.h>
 #include <torch/torch.h>
 
 #include "internal/exceptions.h"
+#include "internal/models.h"
 #include "internal/rl/policy.h"
 
 namespace torchfort {
@@ -229,7 +235,87 @@ std::tuple<torch::Tensor, torch::Tensor> GaussianACPolicy::forwardDeterministic(
 
   return std::make_tuple(action, value);
 }
-  
+
+// float literal for TorchScript source which round-trips exactly
+static std::string script_float(float value) {
+  std::ostringstream os;
+  os << std::scientific << std::setprecision(std::numeric_limits<float>::max_digits10) << value;
+  return os.str();
+}
+
+void export_policy(const std::string& fname, std::shared_ptr<ModelWrapper> model, bool squashed,
+                   ActorNormalizationMode mode, float a_low, float a_high) {
+  torch::NoGradGuard no_grad;
+
+  torch::jit::Module module("TorchFortPolicy");
+  // parameters stay module attributes when freezing, so that the module can be moved to any device after loading
+  std::vector<std::string> preserved_attrs;
+  std::ostringstream src;
+  src << "def forward(self, state: Tensor) -> Tensor:\n";
+
+  auto jit_model = model->jit_model();
+  if (jit_model) {
+    auto policy = jit_model->clone();
+    policy.to(torch::Device(torch::kCPU));
+    auto output_type = policy.get_method("forward").function().getSchema().returns().at(0).type();
+    bool multiple_outputs =
+        (output_type->kind() == c10::TypeKind::TupleType) || (output_type->kind() == c10::TypeKind::ListType);
+    module.register_module("policy", policy);
+    preserved_attrs.push_back("policy");
+    src << "    action = self.policy(state)" << (multiple_outputs ? "[0]" : "") << "\n";
+  } else {
+    auto mlp = std::dynamic_pointer_cast<MLPModel>(model->native_model());
+    if (!mlp || (mlp->n_members > 1)) {
+      THROW_NOT_SUPPORTED("Policy export supports TorchScript policies and MLP models without ensembles.");
+    }
+    src << "    x = state.reshape([state.size(0), -1])\n";
+    size_t n_layers = mlp->fc_layers.size();
+    for (size_t i = 0; i < n_layers; ++i) {
+      // weights are stored as [in, out] for addmm, the extra hidden layer bias is folded into the linear bias
+      auto weight = mlp->fc_layers[i]->weight.detach().t().to(torch::kCPU).contiguous();
+      auto bias = mlp->fc_layers[i]->bias.detach();
+      if (i < n_layers - 1) {
+        bias = bias + mlp->biases[i].detach();
+      }
+      bias = bias.to(torch::kCPU, /* non_blocking = */ false, /* copy = */ true);
+
+      auto suffix = std::to_string(i);
+      module.register_parameter("weight_" + suffix, weight, /* is_buffer = */ false);
+      module.register_parameter("bias_" + suffix, bias, /* is_buffer = */ false);
+      preserved_attrs.push_back("weight_" + suffix);
+      preserved_attrs.push_back("bias_" + suffix);
+
+      auto linear = "torch.addmm(self.bias_" + suffix + ", x, self.weight_" + suffix + ")";
+      if (i < n_layers - 1) {
+        src << "    x = torch.relu(" << linear << ")\n";
+      } else {
+        src << "    action = " << linear << "\n";
+      }
+    }
+  }
+
+  if (squashed) {
+    src << "    action = torch.tanh(action)\n";
+  }
+  switch (mode) {
+  case ActorNormalizationMode::Scale: {
+    // same as unscale_action, with the affine map folded into two constants
+    float half_range = 0.5f * (a_high - a_low);
+    src << "    return action * " << script_float(half_range) << " + " << script_float(half_range + a_low) << "\n";
+    break;
+  }
+  case ActorNormalizationMode::Clip:
+    src << "    return torch.clamp(action, " << script_float(a_low) << ", " << script_float(a_high) << ")\n";
+    break;
+  }
+  module.define(src.str());
+
+  // freezing inlines the policy forward and the action mapping into a single graph
+  module.eval();
+  auto frozen = torch::jit::freeze(module, preserved_attrs);
+  frozen.save(fname);
+}
+
 } // namespace rl
 
 } // namespace torchfort
@@ -0,0 +1,392 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2023 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include <torch/torch.h>
+
+#include "internal/exceptions.h"
+#include "internal/rl/replay_buffer.h"
+
+namespace torchfort {
+
+namespace rl {
+
+TieredReplayBuffer::TieredReplayBuffer(size_t max_size, size_t min_size, size_t hot_size, const std::string& path,
+                                       float gamma, int nstep, RewardReductionMode reward_reduction_mode, int device)
+    : ReplayBuffer(max_size, min_size, device), path_(path), hot_size_(hot_size), head_(0), tail_(0),
+      cold_capacity_(max_size - hot_size), s_bytes_(0), a_bytes_(0), rng_(), gamma_(gamma), nstep_(nstep),
+      n_agents_(1) {
+  if ((hot_size_ == 0) || (hot_size_ > max_size_)) {
+    THROW_INVALID_USAGE("The hot_size of a tiered replay buffer has to be positive and must not exceed max_size.");
+  }
+  if (path_.empty()) {
+    THROW_INVALID_USAGE("The path of a tiered replay buffer has to be set to a directory on node-local storage.");
+  }
+
+  // set up reward reduction mode
+  std::tie(reward_reduction_mode_, skip_incomplete_steps_) = split_reward_reduction_mode(reward_reduction_mode);
+}
+
+void TieredReplayBuffer::update(torch::Tensor s, torch::Tensor a, torch::Tensor sp, float r, bool d) {
+
+  // add no grad guard
+  torch::NoGradGuard no_grad;
+
+  if ((size() > 0) && (n_agents_ != 1)) {
+    THROW_INVALID_USAGE("Replay buffer holds multi-agent data, use the multi-agent update instead.");
+  }
+  n_agents_ = 1;
+
+  // clone the tensors and move to device
+  push(s.to(device_, s.dtype(), /* non_blocking = */ false, /* copy = */ true),
+       a.to(device_, a.dtype(), /* non_blocking = */ false, /* copy = */ true),
+       sp.to(device_, sp.dtype(), /* non_blocking = */ false, /* copy = */ true), r, d);
+
+  evict();
+}
+
+void TieredReplayBuffer::updateMultiAgent(torch::Tensor s, torch::Tensor a, torch::Tensor sp, torch::Tensor r,
+                                          bool d) {
+
+  // add no grad guard
+  torch::NoGradGuard no_grad;
+
+  int64_t n_agents = s.size(0);
+  if ((a.size(0) != n_agents) || (sp.size(0) != n_agents) || (r.numel() != n_agents)) {
+    THROW_INVALID_USAGE("Leading dimension of state, action and reward data has to match the number of agents.");
+  }
+  if ((size() > 0) && (static_cast<size_t>(n_agents) != n_agents_)) {
+    THROW_INVALID_USAGE("The number of agents cannot change between replay buffer updates.");
+  }
+  n_agents_ = n_agents;
+
+  // move the whole batch in one copy, the entries of the individual agents are views into it
+  auto sc = s.to(device_, s.dtype(), /* non_blocking = */ false, /* copy = */ true).unbind(0);
+  auto ac = a.to(device_, a.dtype(), /* non_blocking = */ false, /* copy = */ true).unbind(0);
+  auto spc = sp.to(device_, sp.dtype(), /* non_blocking = */ false, /* copy = */ true).unbind(0);
+  auto rc = r.to(torch::kCPU, torch::kFloat32).reshape({-1}).contiguous();
+  auto r_ptr = rc.data_ptr<float>();
+
+  // agents are stored interleaved, the transitions of agent i are n_agents apart
+  for (int64_t agent = 0; agent < n_agents; ++agent) {
+    push(sc[agent], ac[agent], spc[agent], r_ptr[agent], d);
+  }
+
+  evict();
+}
+
+std::tuple<torch::Tensor, torch::Tensor, torch::Tensor, torch::Tensor, torch::Tensor>
+TieredReplayBuffer::sample(int batch_size) {
+
+  // add no grad guard
+  torch::NoGradGuard no_grad;
+
+  if (valid_.empty()) {
+    THROW_INVALID_USAGE("The replay buffer does not contain any complete n-step rollout.");
+  }
+  // be careful, the interval is CLOSED! We need to exclude the upper bound
+  std::uniform_int_distribution<size_t> uniform_dist(0, valid_.size() - 1);
+
+  // use the starts drawn ahead by the previous call, evicted ones are replaced
+  auto ids = std::move(next_ids_);
+  if (ids.size() != static_cast<size_t>(batch_size)) {
+    ids.assign(batch_size, -1);
+  }
+  for (auto& id : ids) {
+    if (id < head_) {
+      id = valid_[uniform_dist(rng_)];
+    }
+  }
+
+  // we need those
+  auto stens_list = std::vector<torch::Tensor>(batch_size);
+  auto atens_list = std::vector<torch::Tensor>(batch_size);
+  auto sptens_list = std::vector<torch::Tensor>(batch_size);
+  auto r_list = std::vector<float>(batch_size);
+  auto d_list = std::vector<float>(batch_size);
+
+  int64_t window = static_cast<int64_t>((nstep_ - 1) * n_agents_);
+  for (int sample = 0; sample < batch_size; ++sample) {
+    auto index = static_cast<size_t>(ids[sample] - head_);
+
+    // the state and action come from the start of the rollout, the next state from its end
+    std::tie(stens_list[sample], atens_list[sample], std::ignore) = at(ids[sample]);
+    sptens_list[sample] = std::get<2>(at(ids[sample] + window));
+
+    float r;
+    float r_norm = 1.;
+    int r_count = 1;
+    bool d;
+    std::tie(r_list[sample], d) = rd_[index];
+    float deff = (d ? 0. : 1.);
+
+    // if nstep > 1, accumulate the rollout rewards
+    for (int off = 1; off < nstep_; ++off) {
+      std::tie(r, d) = rd_[index + off * n_agents_];
+      auto gamma_eff = static_cast<float>(std::pow(gamma_, off));
+      r_list[sample] += gamma_eff * r;
+      r_norm += gamma_eff;
+      r_count++;
+      if (d) {
+        deff = 0.;
+      }
+    }
+    d_list[sample] = 1. - deff;
+
+    // reward normalization if requested
+    switch (reward_reduction_mode_) {
+    case RewardReductionMode::Mean:
+      r_list[sample] /= static_cast<float>(r_count);
+      break;
+    case RewardReductionMode::WeightedMean:
+      r_list[sample] /= r_norm;
+      break;
+    }
+  }
+
+  // stack the lists, this copies the cold rows out of the mapping
+  auto stens = torch::stack(stens_list, 0);
+  auto atens = torch::stack(atens_list, 0);
+  auto sptens = torch::stack(sptens_list, 0);
+
+  // create new tensors
+  auto options = torch::TensorOptions().dtype(torch::kFloat32);
+  auto rtens = torch::from_blob(r_list.data(), {batch_size, 1}, options).clone();
+  auto dtens = torch::from_blob(d_list.data(), {batch_size, 1}, options).clone();
+
+  // draw the starts of the next batch and start reading their cold rows in the background
+  next_ids_.resize(batch_size);
+  for (auto& id : next_ids_) {
+    id = valid_[uniform_dist(rng_)];
+  }
+  readahead(next_ids_);
+
+  return std::make_tuple(stens, atens, sptens, rtens, dtens);
+}
+
+void TieredReplayBuffer::save(const std::string& fname) const {
+  // create an ordered dict with the buffer contents:
+  std::vector<torch::Tensor> s_data, a_data, sp_data;
+  std::vector<torch::Tensor> r_data, d_data;
+  auto options_f = torch::TensorOptions().dtype(torch::kFloat32).device(torch::kCPU);
+  auto options_b = torch::TensorOptions().dtype(torch::kBool).device(torch::kCPU);
+  for (int64_t id = head_; id < tail_; ++id) {
+    torch::Tensor s, a, sp;
+    std::tie(s, a, sp) = at(id);
+    s_data.push_back(s.to(torch::kCPU, s.dtype(), /* non_blocking = */ false, /* copy = */ true));
+    a_data.push_back(a.to(torch::kCPU, a.dtype(), /* non_blocking = */ false, /* copy = */ true));
+    sp_data.push_back(sp.to(torch::kCPU, sp.dtype(), /* non_blocking = */ false, /* copy = */ true));
+
+    float r;
+    bool d;
+    std::tie(r, d) = rd_[id - head_];
+    r_data.push_back(torch::from_blob(&r, {1}, options_f).clone());
+    d_data.push_back(torch::from_blob(&d, {1}, options_b).clone());
+  }
+
+  // create subdirectory:
+  std::filesystem::path root_dir(fname);
+  if (!std::filesystem::exists(root_dir)) {
+    bool rv = std::filesystem::create_directory(root_dir);
+    if (!rv) {
+      throw std::runtime_error("Could not create directory for replay buffer.");
+    }
+  }
+
+  // save the buffer in the format of the uniform replay buffer
+  torch::save(s_data, root_dir / "s_data.pt");
+  torch::save(sp_data, root_dir / "sp_data.pt");
+  torch::save(a_data, root_dir / "a_data.pt");
+  torch::save(r_data, root_dir / "r_data.pt");
+  torch::save(d_data, root_dir / "d_data.pt");
+  torch::save(torch::tensor({static_cast<int64_t>(n_agents_)}), root_dir / "n_agents.pt");
+}
+
+void TieredReplayBuffer::load(const std::string& fname) {
+  // get vectors for buffers:
+  std::vector<torch::Tensor> s_data, a_data, sp_data;
+  std::vector<torch::Tensor> r_data, d_data;
+
+  std::filesystem::path root_dir(fname);
+  torch::load(s_data, root_dir / "s_data.pt");
+  torch::load(a_data, root_dir / "a_data.pt");
+  torch::load(sp_data, root_dir / "sp_data.pt");
+  torch::load(r_data, root_dir / "r_data.pt");
+  torch::load(d_data, root_dir / "d_data.pt");
+
+  // checkpoints without agent information are single agent buffers
+  n_agents_ = 1;
+  if (std::filesystem::exists(root_dir / "n_agents.pt")) {
+    torch::Tensor n_agents;
+    torch::load(n_agents, root_dir / "n_agents.pt");
+    n_agents_ = n_agents.item<int64_t>();
+  }
+
+  // the cold tier mapping is reused, its rows are overwritten
+  hot_.clear();
+  rd_.clear();
+  valid_.clear();
+  next_ids_.clear();
+  head_ = 0;
+  tail_ = 0;
+
+  // populate the buffer, spilling as we go so that the hot tier stays bounded
+  for (size_t index = 0; index < s_data.size(); ++index) {
+    push(s_data[index].to(device_), a_data[index].to(device_), sp_data[index].to(device_),
+         r_data[index].item<float>(), d_data[index].item<bool>());
+    evict();
+  }
+}
+
+void TieredReplayBuffer::printInfo() const {
+  std::cout << "tiered replay buffer parameters:" << std::endl;
+  std::cout << "max_size = " << max_size_ << std::endl;
+  std::cout << "min_size = " << min_size_ << std::endl;
+  std::cout << "hot_size = " << hot_size_ << std::endl;
+  std::cout << "path = " << path_ << std::endl;
+  std::cout << "n_agents = " << n_agents_ << std::endl;
+}
+
+char* TieredReplayBuffer::coldRow(int64_t id) const {
+  return static_cast<char*>(cold_->record(id % static_cast<int64_t>(cold_capacity_)));
+}
+
+std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> TieredReplayBuffer::at(int64_t id) const {
+  if (id >= hotBegin()) {
+    return hot_[id - hotBegin()];
+  }
+
+  // views into the mapping, only valid until the row is overwritten
+  auto row = coldRow(id);
+  auto options_s = torch::TensorOptions().dtype(s_dtype_).device(torch::kCPU);
+  auto options_a = torch::TensorOptions().dtype(a_dtype_).device(torch::kCPU);
+  auto s = torch::from_blob(row, s_shape_, options_s);
+  auto a = torch::from_blob(row + s_bytes_, a_shape_, options_a);
+  auto sp = torch::from_blob(row + s_bytes_ + a_bytes_, s_shape_, options_s);
+  return std::make_tuple(s.to(device_), a.to(device_), sp.to(device_));
+}
+
+void TieredReplayBuffer::push(torch::Tensor s, torch::Tensor a, torch::Tensor sp, float r, bool d) {
+  hot_.push_back(std::make_tuple(s, a, sp));
+  rd_.push_back(std::make_pair(r, d));
+  tail_++;
+
+  // the newest entry completes the rollout window of the start nstep - 1 time steps earlier. That start is valid
+  // unless incomplete rollouts are skipped and an episode terminates inside the window before its last step.
+  int64_t start = tail_ - 1 - static_cast<int64_t>((nstep_ - 1) * n_agents_);
+  if (start < head_) {
+    return;
+  }
+  if (skip_incomplete_steps_) {
+    for (int off = 1; off < nstep_ - 1; ++off) {
+      if (rd_[start - head_ + off * n_agents_].second) {
+        return;
+      }
+    }
+  }
+  valid_.push_back(start);
+}
+
+void TieredReplayBuffer::evict() {
+  // remove whole time steps so that the agent interleaving is preserved
+  while (size() > max_size_) {
+    for (size_t agent = 0; (agent < n_agents_) && (size() > 0); ++agent) {
+      // cold rows are simply overwritten later
+      if (head_ >= hotBegin()) {
+        hot_.pop_front();
+      }
+      rd_.pop_front();
+      head_++;
+    }
+  }
+
+  // starts are inserted in increasing order, the evicted ones are at the front
+  while (!valid_.empty() && (valid_.front() < head_)) {
+    valid_.pop_front();
+  }
+
+  // move the oldest hot transitions to the cold tier
+  while (hot_.size() > hot_size_) {
+    spill();
+  }
+}
+
+void TieredReplayBuffer::spill() {
+  auto s = std::get<0>(hot_.front()).to(torch::kCPU).contiguous();
+  auto a = std::get<1>(hot_.front()).to(torch::kCPU).contiguous();
+  auto sp = std::get<2>(hot_.front()).to(torch::kCPU).contiguous();
+  if (!cold_) {
+    createColdTier(s, a);
+  }
+  if ((s.nbytes() != s_bytes_) || (a.nbytes() != a_bytes_) || (sp.nbytes() != s_bytes_)) {
+    THROW_INVALID_USAGE("All transitions of a tiered replay buffer need to have the same state and action shapes.");
+  }
+
+  auto row = coldRow(hotBegin());
+  std::memcpy(row, s.data_ptr(), s_bytes_);
+  std::memcpy(row + s_bytes_, a.data_ptr(), a_bytes_);
+  std::memcpy(row + s_bytes_ + a_bytes_, sp.data_ptr(), s_bytes_);
+  hot_.pop_front();
+}
+
+void TieredReplayBuffer::createColdTier(const torch::Tensor& s, const torch::Tensor& a) {
+  s_shape_ = s.sizes().vec();
+  a_shape_ = a.sizes().vec();
+  s_dtype_ = s.scalar_type();
+  a_dtype_ = a.scalar_type();
+  s_bytes_ = s.nbytes();
+  a_bytes_ = a.nbytes();
+  cold_ = std::make_unique<SpillFile>(path_, cold_capacity_, 2 * s_bytes_ + a_bytes_);
+}
+
+void TieredReplayBuffer::readahead(const std::vector<int64_t>& ids) const {
+  // both ends of the rollout window of every start, rows still in the hot tier need no readahead
+  const int64_t window = static_cast<int64_t>((nstep_ - 1) * n_agents_);
+  std::vector<int64_t> rows;
+  rows.reserve(2 * ids.size());
+  for (auto id : ids) {
+    for (auto row_id : {id, id + window}) {
+      if (row_id < hotBegin()) {
+        rows.push_back(row_id % static_cast<int64_t>(cold_capacity_));
+      }
+    }
+  }
+  if (!rows.empty()) {
+    cold_->prefetch(rows.data(), rows.size());
+  }
+}
+
+} // namespace rl
+
+} // namespace torchfort
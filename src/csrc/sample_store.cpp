@@ -0,0 +1,319 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2023 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include <torch/torch.h>
+#include <yaml-cpp/yaml.h>
+
+#include "internal/exceptions.h"
+#include "internal/param_map.h"
+#include "internal/sample_store.h"
+#include "internal/setup.h"
+#include "internal/utils.h"
+
+namespace torchfort {
+
+SampleStore::SampleStore(size_t capacity, size_t batch_size, SampleStorePolicy policy, torch::Device device,
+                         const std::string& spill_dir)
+    : capacity_(capacity), batch_size_(batch_size), policy_(policy), device_(device), spill_dir_(spill_dir), rng_() {
+  if (batch_size_ > capacity_) {
+    THROW_INVALID_USAGE("sample store batch_size must not exceed the capacity.");
+  }
+}
+
+void SampleStore::allocate(const torch::Tensor& inputs, const torch::Tensor& labels) {
+  auto input_shape = inputs.sizes().vec();
+  auto label_shape = labels.sizes().vec();
+  input_shape[0] = capacity_;
+  label_shape[0] = capacity_;
+
+  if (spill_dir_.empty()) {
+    inputs_ = torch::empty(input_shape, inputs.options().device(device_));
+    labels_ = torch::empty(label_shape, labels.options().device(device_));
+    return;
+  }
+
+  // fixed-record layout: every record holds an input sample followed by its label sample, both padded to 8 bytes
+  auto padded = [](size_t n) { return (n + 7) / 8 * 8; };
+  size_t input_bytes = padded(inputs.numel() / std::max<int64_t>(inputs.size(0), 1) * inputs.element_size());
+  size_t label_bytes = padded(labels.numel() / std::max<int64_t>(labels.size(0), 1) * labels.element_size());
+  spill_ = std::make_unique<SpillFile>(spill_dir_, capacity_, input_bytes + label_bytes);
+
+  // sample tensors are strided views of the mapping, so samples are read and written without (de)serialization
+  auto record_strides = [&](const std::vector<int64_t>& shape, int64_t element_size) {
+    std::vector<int64_t> strides(shape.size());
+    int64_t stride = 1;
+    for (int64_t i = shape.size() - 1; i > 0; --i) {
+      strides[i] = stride;
+      stride *= shape[i];
+    }
+    strides[0] = spill_->recordBytes() / element_size;
+    return strides;
+  };
+  auto options = torch::TensorOptions().device(torch::kCPU);
+  inputs_ = torch::from_blob(spill_->data(), input_shape, record_strides(input_shape, inputs.element_size()),
+                             options.dtype(inputs.dtype()));
+  labels_ = torch::from_blob(static_cast<char*>(spill_->data()) + input_bytes, label_shape,
+                             record_strides(label_shape, labels.element_size()), options.dtype(labels.dtype()));
+}
+
+// compute the store slots for n new samples, src_indices selects the samples which are kept. Every slot occurs at
+// most once, the scatter of duplicate destinations would be nondeterministic.
+torch::Tensor SampleStore::insertIndices(int64_t n, torch::Tensor& src_indices) {
+  std::vector<int64_t> src, dst;
+  src.reserve(n);
+  dst.reserve(n);
+
+  switch (policy_) {
+  case Ring:
+    // only the newest capacity samples survive
+    for (int64_t i = std::max<int64_t>(0, n - static_cast<int64_t>(capacity_)); i < n; ++i) {
+      src.push_back(i);
+      dst.push_back((head_ + i) % capacity_);
+    }
+    head_ = (head_ + n) % capacity_;
+    size_ = std::min(size_ + n, capacity_);
+    break;
+  case Reservoir: {
+    // every sample seen so far is kept with equal probability capacity / n_seen. A slot drawn again within this
+    // batch receives the later sample, like with sequential insertion.
+    std::unordered_map<int64_t, size_t> slot_pos;
+    for (int64_t i = 0; i < n; ++i) {
+      if (size_ < capacity_) {
+        slot_pos.emplace(size_, src.size());
+        src.push_back(i);
+        dst.push_back(size_++);
+      } else {
+        std::uniform_int_distribution<int64_t> dist(0, n_seen_);
+        auto j = dist(rng_);
+        if (j < static_cast<int64_t>(capacity_)) {
+          auto [it, inserted] = slot_pos.try_emplace(j, src.size());
+          if (inserted) {
+            src.push_back(i);
+            dst.push_back(j);
+          } else {
+            src[it->second] = i;
+          }
+        }
+      }
+      n_seen_++;
+    }
+    break;
+  }
+  }
+
+  src_indices = torch::tensor(src, torch::kInt64);
+  return torch::tensor(dst, torch::kInt64);
+}
+
+void SampleStore::add(torch::Tensor inputs, torch::Tensor labels) {
+  torch::NoGradGuard no_grad;
+
+  if (inputs.size(0) != labels.size(0)) {
+    THROW_INVALID_USAGE("Number of input and label samples must match.");
+  }
+
+  if (!inputs_.defined()) {
+    allocate(inputs, labels);
+  } else if (inputs.sizes().slice(1) != inputs_.sizes().slice(1) ||
+             labels.sizes().slice(1) != labels_.sizes().slice(1)) {
+    THROW_INVALID_USAGE("Sample shapes do not match the samples already in the store.");
+  }
+
+  torch::Tensor src_indices;
+  auto dst_indices = insertIndices(inputs.size(0), src_indices);
+  if (dst_indices.numel() == 0) {
+    return;
+  }
+
+  // a single bulk scatter per tensor
+  if (priorities_) {
+    auto dst = dst_indices.accessor<int64_t, 1>();
+    for (int64_t i = 0; i < dst.size(0); ++i) {
+      priorities_->set(dst[i], max_priority_);
+    }
+  }
+
+  auto storage_device = storageDevice();
+  src_indices = src_indices.to(inputs.device());
+  dst_indices = dst_indices.to(storage_device);
+  inputs_.index_copy_(0, dst_indices, inputs.index_select(0, src_indices).to(storage_device, inputs_.dtype()));
+  labels_.index_copy_(0, dst_indices, labels.index_select(0, src_indices).to(storage_device, labels_.dtype()));
+}
+
+std::tuple<torch::Tensor, torch::Tensor> SampleStore::sample(size_t n_samples) {
+  torch::NoGradGuard no_grad;
+
+  int64_t batch_size = n_samples > 0 ? n_samples : batch_size_;
+  if (static_cast<int64_t>(size_) < batch_size) {
+    THROW_INVALID_USAGE("Sample store holds fewer samples than the requested batch size.");
+  }
+
+  // reshuffle once the current permutation is used up or the store has grown
+  int64_t size = size_;
+  if (!order_.defined() || order_pos_ + batch_size > order_.size(0) || order_.size(0) != size) {
+    order_ = torch::randperm(size, torch::TensorOptions().dtype(torch::kInt64).device(storageDevice()));
+    order_pos_ = 0;
+  }
+  auto indices = order_.slice(0, order_pos_, order_pos_ + batch_size);
+  order_pos_ += batch_size;
+
+  if (spill_) {
+    auto inputs = inputs_.index_select(0, indices).to(device_);
+    auto labels = labels_.index_select(0, indices).to(device_);
+
+    // start reading the records of the next minibatch in the background, reshuffling early if required
+    if (order_pos_ + batch_size > size) {
+      order_ = torch::randperm(size, torch::TensorOptions().dtype(torch::kInt64).device(storageDevice()));
+      order_pos_ = 0;
+    }
+    spill_->prefetch(order_.data_ptr<int64_t>() + order_pos_, batch_size);
+    return std::make_tuple(inputs, labels);
+  }
+
+  return std::make_tuple(inputs_.index_select(0, indices), labels_.index_select(0, indices));
+}
+
+void SampleStore::enablePriorities(double alpha, double beta, double eps) {
+  alpha_ = alpha;
+  beta_ = beta;
+  eps_ = eps;
+  priorities_ = std::make_unique<SumTree>(capacity_);
+}
+
+std::tuple<torch::Tensor, torch::Tensor, torch::Tensor, torch::Tensor>
+SampleStore::samplePrioritized(size_t n_samples) {
+  torch::NoGradGuard no_grad;
+
+  int64_t batch_size = n_samples > 0 ? n_samples : batch_size_;
+  if (static_cast<int64_t>(size_) < batch_size) {
+    THROW_INVALID_USAGE("Sample store holds fewer samples than the requested batch size.");
+  }
+
+  // with spilling, the minibatch was drawn ahead at the end of the previous call
+  torch::Tensor indices;
+  if (next_indices_.defined() && next_indices_.size(0) == batch_size) {
+    indices = std::move(next_indices_);
+  } else {
+    indices = drawPrioritized(batch_size);
+  }
+  next_indices_ = torch::Tensor();
+
+  // importance weights from the current priorities
+  double total = priorities_->total();
+  auto weights = torch::empty({batch_size}, torch::kFloat32);
+  auto indices_a = indices.accessor<int64_t, 1>();
+  auto weights_a = weights.accessor<float, 1>();
+  double max_weight = 0.0;
+  for (int64_t i = 0; i < batch_size; ++i) {
+    double weight = std::pow(size_ * priorities_->get(indices_a[i]) / total, -beta_);
+    weights_a[i] = weight;
+    max_weight = std::max(max_weight, weight);
+  }
+  weights.div_(max_weight);
+
+  auto storage_indices = indices.to(storageDevice());
+  auto inputs = inputs_.index_select(0, storage_indices).to(device_);
+  auto labels = labels_.index_select(0, storage_indices).to(device_);
+
+  // start reading the records of the next minibatch in the background
+  if (spill_) {
+    next_indices_ = drawPrioritized(batch_size);
+    spill_->prefetch(next_indices_.data_ptr<int64_t>(), batch_size);
+  }
+  return std::make_tuple(inputs, labels, weights.to(device_), indices);
+}
+
+// stratified sampling: one draw from each of batch_size equal slices of the total priority
+torch::Tensor SampleStore::drawPrioritized(int64_t batch_size) {
+  double segment = priorities_->total() / batch_size;
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  auto indices = torch::empty({batch_size}, torch::kInt64);
+  auto indices_a = indices.accessor<int64_t, 1>();
+  for (int64_t i = 0; i < batch_size; ++i) {
+    indices_a[i] = priorities_->find((i + uniform(rng_)) * segment);
+  }
+  return indices;
+}
+
+void SampleStore::updatePriorities(const torch::Tensor& indices, const torch::Tensor& sample_losses) {
+  auto priorities = (sample_losses.detach().to(torch::kCPU, torch::kFloat64) + eps_).pow(alpha_);
+  auto indices_a = indices.accessor<int64_t, 1>();
+  auto priorities_a = priorities.accessor<double, 1>();
+  for (int64_t i = 0; i < indices_a.size(0); ++i) {
+    priorities_->set(indices_a[i], priorities_a[i]);
+    max_priority_ = std::max(max_priority_, priorities_a[i]);
+  }
+}
+
+std::shared_ptr<SampleStore> get_sample_store(const YAML::Node& sample_store_node, torch::Device device) {
+  auto params = get_params(sample_store_node);
+  std::set<std::string> supported_params{"capacity",    "batch_size", "policy", "spill_dir",
+                                         "prioritized", "alpha",      "beta",   "epsilon"};
+  check_params(supported_params, params.keys());
+
+  size_t capacity, batch_size;
+  try {
+    capacity = params.get_param<int>("capacity")[0];
+    batch_size = params.get_param<int>("batch_size")[0];
+  } catch (std::out_of_range) {
+    THROW_INVALID_USAGE("capacity and batch_size parameters are required for the sample store.");
+  }
+
+  SampleStorePolicy policy;
+  auto policy_name = sanitize(params.get_param<std::string>("policy", "ring")[0]);
+  if (policy_name == "ring") {
+    policy = Ring;
+  } else if (policy_name == "reservoir") {
+    policy = Reservoir;
+  } else {
+    THROW_INVALID_USAGE("Unknown sample store policy " + policy_name + ". Supported policies are: ring, reservoir.");
+  }
+
+  // paths are case sensitive, so the value is not sanitized
+  auto spill_dir = params.get_param<std::string>("spill_dir", "")[0];
+
+  auto sample_store = std::make_shared<SampleStore>(capacity, batch_size, policy, device, spill_dir);
+
+  if (params.get_param<bool>("prioritized", false)[0]) {
+    sample_store->enablePriorities(params.get_param<double>("alpha", 0.6)[0], params.get_param<double>("beta", 0.4)[0],
+                                   params.get_param<double>("epsilon", 1e-6)[0]);
+  }
+
+  return sample_store;
+}
+
+} // namespace torchfort
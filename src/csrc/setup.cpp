@@ -105,8 +105,20 @@ ParamMap get_params(const YAML::Node& params_node) {
 std::shared_ptr<ModelWrapper> get_model(const YAML::Node& model_node) {
   auto model_type = sanitize(model_node["type"].as<std::string>());
 
+  int ensemble_size = 1;
+  if (model_node["ensemble_size"]) {
+    ensemble_size = model_node["ensemble_size"].as<int>();
+    if (ensemble_size < 1) {
+      THROW_INVALID_USAGE("ensemble_size must be a positive integer.");
+    }
+  }
+
   std::shared_ptr<ModelWrapper> model = nullptr;
   if (model_type == "torchscript") {
+    if (ensemble_size > 1) {
+      THROW_NOT_SUPPORTED("ensemble_size is not supported for torchscript models.");
+    }
+
     auto model_params = get_params(model_node["parameters"]);
     try {
       auto torchscript_fname = model_params.get_param<std::string>("filename")[0];
@@ -115,6 +127,13 @@ std::shared_ptr<ModelWrapper> get_model(const YAML::Node& model_node) {
       THROW_INVALID_USAGE("filename parameter is required for torchscript model type.");
     }
 
+    model->set_stateful(model_params.get_param<bool>("stateful", false)[0]);
+
+    if (model_params.get_param<bool>("checkpoint_activations", false)[0]) {
+      // a segment count of 0 selects the default based on the number of layers
+      model->enable_activation_checkpointing(model_params.get_param<int>("checkpoint_segments", 0)[0]);
+    }
+
   } else {
     std::shared_ptr<BaseModel> m = nullptr;
     try {
@@ -134,6 +153,13 @@ std::shared_ptr<ModelWrapper> get_model(const YAML::Node& model_node) {
     }
 
     auto model_params = get_params(model_node["parameters"]);
+    if (ensemble_size > 1) {
+      if (m->batched_ensemble()) {
+        model_params.add_param("ensemble_size", std::vector<std::string>{std::to_string(ensemble_size)});
+      } else {
+        m = std::make_shared<EnsembleModel>(model_registry.at(model_type), ensemble_size);
+      }
+    }
     m->setup(model_params);
     model = std::make_shared<ModelWrapper>(m);
   }
@@ -168,7 +194,7 @@ std::shared_ptr<BaseLoss> get_loss(const YAML::Node& loss_node) {
 
 std::shared_ptr<torch::optim::Optimizer> get_optimizer(const YAML::Node& optimizer_node,
                                                        const std::shared_ptr<ModelWrapper>& model) {
-  auto parameters = model->parameters();
+  auto parameters = model->trainable_parameters();
   return get_optimizer(optimizer_node, parameters);
 }
 
@@ -275,7 +301,7 @@ std::shared_ptr<ModelState> get_state(const char* name, const YAML::Node& state_
 
   if (state_node["general"]) {
     auto params = get_params(state_node["general"]);
-    std::set<std::string> supported_params{"report_frequency", "enable_wandb_hook", "verbose"};
+    std::set<std::string> supported_params{"report_frequency", "enable_wandb_hook", "verbose", "track_episodes"};
     check_params(supported_params, params.keys());
     state->report_frequency = params.get_param<int>("report_frequency")[0];
     try {
@@ -318,6 +344,12 @@ std::shared_ptr<ModelState> get_state(const char* name, const YAML::Node& state_
     } catch (std::out_of_range) {
       state->verbose = false;
     }
+
+    try {
+      state->track_episodes = params.get_param<bool>("track_episodes")[0];
+    } catch (std::out_of_range) {
+      state->track_episodes = false;
+    }
   }
 
   return state;
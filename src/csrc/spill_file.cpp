@@ -0,0 +1,92 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2023 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "internal/exceptions.h"
+#include "internal/spill_file.h"
+
+namespace torchfort {
+
+SpillFile::SpillFile(const std::string& dir, size_t n_records, size_t record_bytes)
+    : n_records_(n_records), record_bytes_(record_bytes), size_bytes_(n_records * record_bytes),
+      page_size_(sysconf(_SC_PAGESIZE)) {
+  std::string path = dir + "/torchfort_spill_XXXXXX";
+  std::vector<char> path_buf(path.begin(), path.end());
+  path_buf.push_back('\0');
+
+  int fd = mkstemp(path_buf.data());
+  if (fd < 0) {
+    THROW_INVALID_USAGE("Could not create spill file in " + dir + ": " + std::strerror(errno));
+  }
+  unlink(path_buf.data());
+
+  // reserve the full extent up front, so running out of disk space is reported here and not as SIGBUS later
+  int rv = posix_fallocate(fd, 0, size_bytes_);
+  if (rv != 0) {
+    close(fd);
+    THROW_INVALID_USAGE("Could not allocate " + std::to_string(size_bytes_) + " bytes for spill file in " + dir + ": " +
+                        std::strerror(rv));
+  }
+
+  addr_ = mmap(nullptr, size_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr_ == MAP_FAILED) {
+    addr_ = nullptr;
+    THROW_INTERNAL_ERROR(std::string("Could not map spill file: ") + std::strerror(errno));
+  }
+
+  // records are accessed in random order, sequential readahead would only pollute the page cache
+  madvise(addr_, size_bytes_, MADV_RANDOM);
+}
+
+SpillFile::~SpillFile() {
+  if (addr_) {
+    munmap(addr_, size_bytes_);
+  }
+}
+
+void SpillFile::prefetch(const int64_t* records, size_t n) const {
+  for (size_t i = 0; i < n; ++i) {
+    auto begin = reinterpret_cast<uintptr_t>(record(records[i]));
+    auto page_begin = begin - begin % page_size_;
+    madvise(reinterpret_cast<void*>(page_begin), begin + record_bytes_ - page_begin, MADV_WILLNEED);
+  }
+}
+
+} // namespace torchfort
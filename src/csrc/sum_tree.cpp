@@ -0,0 +1,70 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2023 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdint>
+#include <vector>
+
+#include "internal/sum_tree.h"
+
+namespace torchfort {
+
+SumTree::SumTree(size_t capacity) : capacity_(capacity), leaves_(1) {
+  while (leaves_ < capacity_) {
+    leaves_ *= 2;
+  }
+  // implicit heap layout: node i has children 2i and 2i + 1, leaves start at leaves_
+  tree_.assign(2 * leaves_, 0.0);
+}
+
+void SumTree::set(int64_t index, double value) {
+  size_t node = leaves_ + index;
+  double delta = value - tree_[node];
+  for (; node >= 1; node /= 2) {
+    tree_[node] += delta;
+  }
+}
+
+int64_t SumTree::find(double value) const {
+  size_t node = 1;
+  while (node < leaves_) {
+    size_t left = 2 * node;
+    if (value < tree_[left] || tree_[left + 1] <= 0.0) {
+      node = left;
+    } else {
+      value -= tree_[left];
+      node = left + 1;
+    }
+  }
+  // guard against rounding pushing the search past the last occupied leaf
+  int64_t index = node - leaves_;
+  return index < static_cast<int64_t>(capacity_) ? index : capacity_ - 1;
+}
+
+} // namespace torchfort
@@ -42,9 +42,11 @@
 #include <yaml-cpp/yaml.h>
 
 #include "internal/base_model.h"
+#include "internal/dataset.h"
 #include "internal/exceptions.h"
 #include "internal/model_wrapper.h"
 #include "internal/models.h"
+#include "internal/pipeline.h"
 #include "internal/setup.h"
 #include "internal/training.h"
 #include "internal/utils.h"
@@ -53,6 +55,7 @@
 namespace torchfort {
 // Global variables
 std::unordered_map<std::string, ModelPack> models;
+std::unordered_map<std::string, std::shared_ptr<Pipeline>> pipelines;
 } // namespace torchfort
 
 torchfort_result_t torchfort_set_cudnn_benchmark(const bool flag) {
@@ -96,6 +99,11 @@ torchfort_result_t torchfort_create_model(const char* name, const char* config_f
     }
 
 
+    // Freezing parameters, before the optimizer collects the trainable ones
+    if (config["trainable_parameters"]) {
+      models[name].model->set_trainable_parameters(config["trainable_parameters"].as<std::vector<std::string>>());
+    }
+
     // Setting up loss
     if (config["loss"]) {
       models[name].loss = get_loss(config["loss"]);
@@ -117,6 +125,35 @@ torchfort_result_t torchfort_create_model(const char* name, const char* config_f
 
     // Setting up general options
     models[name].state = get_state(name, config);
+
+    // Setting up normalization
+    if (config["normalization"]) {
+      models[name].normalizer = get_normalizer(config["normalization"], models[name].model->device(),
+                                               models[name].state->report_frequency);
+    }
+
+    // Setting up sample store
+    if (config["sample_store"]) {
+      models[name].sample_store = get_sample_store(config["sample_store"], models[name].model->device());
+    }
+
+    // Setting up asynchronous training queue
+    if (config["async_training"]) {
+      // the model pack is captured once, elements of the registry keep their address when it is rehashed
+      std::string model_name(name);
+      ModelPack* model_pack = &models[name];
+      auto step_fn = [model_name, model_pack](torch::Tensor input, torch::Tensor label) {
+        double loss_val;
+        train_step(model_name.c_str(), *model_pack, input, label, &loss_val);
+        return loss_val;
+      };
+      models[name].async_trainer = get_async_trainer(config["async_training"], step_fn, models[name].model->device());
+    }
+
+    // Setting up hidden state storage for stateful models
+    if (models[name].model->stateful()) {
+      models[name].recurrent_state = std::make_shared<RecurrentState>();
+    }
   } catch (const BaseException& e) {
     std::cerr << e.what();
     return e.getResult();
@@ -131,6 +168,17 @@ torchfort_result_t torchfort_create_distributed_model(const char* name, const ch
   try {
     torchfort_create_model(name, config_fname, device);
 
+    // the training thread communicates concurrently with MPI calls of the application
+    if (models[name].async_trainer) {
+      int provided;
+      CHECK_MPI(MPI_Query_thread(&provided));
+      if (provided < MPI_THREAD_MULTIPLE) {
+        models[name].async_trainer.reset();
+        THROW_INVALID_USAGE("async_training of distributed models requires MPI to be initialized with "
+                            "MPI_THREAD_MULTIPLE.");
+      }
+    }
+
     // Set up distributed communicator
     models[name].comm = std::shared_ptr<Comm>(new Comm(mpi_comm));
     models[name].comm->initialize(models[name].model->device().is_cuda());
@@ -165,6 +213,122 @@ WANDB_LOG_FUNC(int)
 WANDB_LOG_FUNC(float)
 WANDB_LOG_FUNC(double)
 
+static void set_graph(const char* name, int64_t n_nodes, int64_t n_edges, int64_t* row_offsets,
+                      int64_t* col_indices, int64_t index_base) {
+  using namespace torchfort;
+  wait_async_training(name);
+  // ensembles of GNN models share the connectivity, every member caches it
+  std::vector<std::shared_ptr<BaseModel>> members{models[name].model->native_model()};
+  auto ensemble = std::dynamic_pointer_cast<EnsembleModel>(members[0]);
+  if (ensemble) {
+    members = ensemble->members;
+  }
+  std::vector<std::shared_ptr<GNNModel>> gnns;
+  for (const auto& member : members) {
+    auto gnn = std::dynamic_pointer_cast<GNNModel>(member);
+    if (!gnn) {
+      THROW_INVALID_USAGE("Graph connectivity can only be registered for models of type GNN.");
+    }
+    gnns.push_back(gnn);
+  }
+
+  int64_t n_offsets = n_nodes + 1;
+  auto row_offsets_tensor = get_tensor<RowMajor>(row_offsets, 1, &n_offsets);
+  auto col_indices_tensor = get_tensor<RowMajor>(col_indices, 1, &n_edges);
+  for (auto& gnn : gnns) {
+    gnn->set_graph(n_nodes, row_offsets_tensor, col_indices_tensor, index_base);
+  }
+}
+
+torchfort_result_t torchfort_set_graph(const char* name, int64_t n_nodes, int64_t n_edges, int64_t* row_offsets,
+                                       int64_t* col_indices) {
+  using namespace torchfort;
+  try {
+    set_graph(name, n_nodes, n_edges, row_offsets, col_indices, 0);
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
+torchfort_result_t torchfort_set_graph_F(const char* name, int64_t n_nodes, int64_t n_edges, int64_t* row_offsets,
+                                         int64_t* col_indices) {
+  using namespace torchfort;
+  try {
+    // Fortran connectivity uses 1-based indices
+    set_graph(name, n_nodes, n_edges, row_offsets, col_indices, 1);
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
+static torchfort::RecurrentState* get_recurrent_state(const char* name) {
+  using namespace torchfort;
+  if (!models[name].recurrent_state) {
+    THROW_INVALID_USAGE("Model " + std::string(name) + " is not stateful.");
+  }
+  return models[name].recurrent_state.get();
+}
+
+torchfort_result_t torchfort_set_state_stream(const char* name, int64_t stream_id) {
+  using namespace torchfort;
+  try {
+    get_recurrent_state(name)->active_stream = stream_id;
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
+torchfort_result_t torchfort_reset_state(const char* name, int64_t stream_id) {
+  using namespace torchfort;
+  try {
+    get_recurrent_state(name)->streams.erase(stream_id);
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
+torchfort_result_t torchfort_reset_all_states(const char* name) {
+  using namespace torchfort;
+  try {
+    get_recurrent_state(name)->streams.clear();
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
+torchfort_result_t torchfort_set_ensemble_output(const char* name, torchfort_ensemble_output_t output) {
+  using namespace torchfort;
+  try {
+    if (models[name].model->ensemble_size() == 1) {
+      THROW_INVALID_USAGE("Model " + std::string(name) + " is not an ensemble.");
+    }
+    switch (output) {
+    case TORCHFORT_ENSEMBLE_MEAN:
+    case TORCHFORT_ENSEMBLE_VARIANCE:
+    case TORCHFORT_ENSEMBLE_ALL:
+      models[name].state->ensemble_output = output;
+      break;
+    default:
+      THROW_INVALID_USAGE("Unknown ensemble output provided.");
+      break;
+    }
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
 torchfort_result_t torchfort_train(const char* name, void* input, size_t input_dim, int64_t* input_shape, void* label,
                                    size_t label_dim, int64_t* label_shape, void* loss_val, torchfort_datatype_t dtype,
                                    cudaStream_t stream) {
@@ -219,6 +383,178 @@ torchfort_result_t torchfort_train_F(const char* name, void* input, size_t input
   return TORCHFORT_RESULT_SUCCESS;
 }
 
+torchfort_result_t torchfort_train_dataset(const char* name, const char* dataset_config_fname) {
+  using namespace torchfort;
+  try {
+    torchfort::train_dataset(name, dataset_config_fname);
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
+torchfort_result_t torchfort_train_async(const char* name, void* input, size_t input_dim, int64_t* input_shape,
+                                         void* label, size_t label_dim, int64_t* label_shape,
+                                         torchfort_datatype_t dtype, cudaStream_t stream) {
+  using namespace torchfort;
+  try {
+    switch (dtype) {
+    case TORCHFORT_FLOAT:
+      torchfort::train_async<torchfort::RowMajor>(name, reinterpret_cast<float*>(input), input_dim, input_shape,
+                                                  reinterpret_cast<float*>(label), label_dim, label_shape, stream);
+      break;
+    case TORCHFORT_DOUBLE:
+      torchfort::train_async<torchfort::RowMajor>(name, reinterpret_cast<double*>(input), input_dim, input_shape,
+                                                  reinterpret_cast<double*>(label), label_dim, label_shape, stream);
+      break;
+    default:
+      THROW_INVALID_USAGE("Unknown datatype provided.");
+      break;
+    }
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
+torchfort_result_t torchfort_train_async_F(const char* name, void* input, size_t input_dim, int64_t* input_shape,
+                                           void* label, size_t label_dim, int64_t* label_shape,
+                                           torchfort_datatype_t dtype, cudaStream_t stream) {
+  using namespace torchfort;
+  try {
+    switch (dtype) {
+    case TORCHFORT_FLOAT:
+      torchfort::train_async<torchfort::ColMajor>(name, reinterpret_cast<float*>(input), input_dim, input_shape,
+                                                  reinterpret_cast<float*>(label), label_dim, label_shape, stream);
+      break;
+    case TORCHFORT_DOUBLE:
+      torchfort::train_async<torchfort::ColMajor>(name, reinterpret_cast<double*>(input), input_dim, input_shape,
+                                                  reinterpret_cast<double*>(label), label_dim, label_shape, stream);
+      break;
+    default:
+      THROW_INVALID_USAGE("Unknown datatype provided.");
+      break;
+    }
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
+torchfort_result_t torchfort_train_wait(const char* name) {
+  using namespace torchfort;
+  try {
+    if (!models[name].async_trainer) {
+      THROW_INVALID_USAGE("Model " + std::string(name) + " has no asynchronous training queue.");
+    }
+    models[name].async_trainer->wait();
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
+torchfort_result_t torchfort_get_loss(const char* name, void* loss_val, torchfort_datatype_t dtype) {
+  using namespace torchfort;
+  try {
+    if (!models[name].async_trainer) {
+      THROW_INVALID_USAGE("Model " + std::string(name) + " has no asynchronous training queue.");
+    }
+    double loss = models[name].async_trainer->loss();
+    switch (dtype) {
+    case TORCHFORT_FLOAT:
+      *reinterpret_cast<float*>(loss_val) = static_cast<float>(loss);
+      break;
+    case TORCHFORT_DOUBLE:
+      *reinterpret_cast<double*>(loss_val) = loss;
+      break;
+    default:
+      THROW_INVALID_USAGE("Unknown datatype provided.");
+      break;
+    }
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
+torchfort_result_t torchfort_add_samples(const char* name, void* input, size_t input_dim, int64_t* input_shape,
+                                         void* label, size_t label_dim, int64_t* label_shape,
+                                         torchfort_datatype_t dtype, cudaStream_t stream) {
+  using namespace torchfort;
+  try {
+    switch (dtype) {
+    case TORCHFORT_FLOAT:
+      torchfort::add_samples<torchfort::RowMajor>(name, reinterpret_cast<float*>(input), input_dim, input_shape,
+                                                  reinterpret_cast<float*>(label), label_dim, label_shape, stream);
+      break;
+    case TORCHFORT_DOUBLE:
+      torchfort::add_samples<torchfort::RowMajor>(name, reinterpret_cast<double*>(input), input_dim, input_shape,
+                                                  reinterpret_cast<double*>(label), label_dim, label_shape, stream);
+      break;
+    default:
+      THROW_INVALID_USAGE("Unknown datatype provided.");
+      break;
+    }
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
+torchfort_result_t torchfort_add_samples_F(const char* name, void* input, size_t input_dim, int64_t* input_shape,
+                                           void* label, size_t label_dim, int64_t* label_shape,
+                                           torchfort_datatype_t dtype, cudaStream_t stream) {
+  using namespace torchfort;
+  try {
+    switch (dtype) {
+    case TORCHFORT_FLOAT:
+      torchfort::add_samples<torchfort::ColMajor>(name, reinterpret_cast<float*>(input), input_dim, input_shape,
+                                                  reinterpret_cast<float*>(label), label_dim, label_shape, stream);
+      break;
+    case TORCHFORT_DOUBLE:
+      torchfort::add_samples<torchfort::ColMajor>(name, reinterpret_cast<double*>(input), input_dim, input_shape,
+                                                  reinterpret_cast<double*>(label), label_dim, label_shape, stream);
+      break;
+    default:
+      THROW_INVALID_USAGE("Unknown datatype provided.");
+      break;
+    }
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
+torchfort_result_t torchfort_train_from_store(const char* name, int64_t n_steps, void* loss_val,
+                                              torchfort_datatype_t dtype, cudaStream_t stream) {
+  using namespace torchfort;
+  try {
+    switch (dtype) {
+    case TORCHFORT_FLOAT:
+      torchfort::train_from_store(name, n_steps, reinterpret_cast<float*>(loss_val), stream);
+      break;
+    case TORCHFORT_DOUBLE:
+      torchfort::train_from_store(name, n_steps, reinterpret_cast<double*>(loss_val), stream);
+      break;
+    default:
+      THROW_INVALID_USAGE("Unknown datatype provided.");
+      break;
+    }
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
 torchfort_result_t torchfort_inference(const char* name, void* input, size_t input_dim, int64_t* input_shape,
                                        void* output, size_t output_dim, int64_t* output_shape,
                                        torchfort_datatype_t dtype, cudaStream_t stream) {
@@ -269,9 +605,143 @@ torchfort_result_t torchfort_inference_F(const char* name, void* input, size_t i
   return TORCHFORT_RESULT_SUCCESS;
 }
 
+torchfort_result_t torchfort_inference_mc(const char* name, void* input, size_t input_dim, int64_t* input_shape,
+                                          int64_t n_samples, void* mean, size_t mean_dim, int64_t* mean_shape,
+                                          void* var, size_t var_dim, int64_t* var_shape, torchfort_datatype_t dtype,
+                                          cudaStream_t stream) {
+  using namespace torchfort;
+  try {
+    switch (dtype) {
+    case TORCHFORT_FLOAT:
+      torchfort::inference_mc<torchfort::RowMajor>(name, reinterpret_cast<float*>(input), input_dim, input_shape,
+                                                   n_samples, reinterpret_cast<float*>(mean), mean_dim, mean_shape,
+                                                   reinterpret_cast<float*>(var), var_dim, var_shape, stream);
+      break;
+    case TORCHFORT_DOUBLE:
+      torchfort::inference_mc<torchfort::RowMajor>(name, reinterpret_cast<double*>(input), input_dim, input_shape,
+                                                   n_samples, reinterpret_cast<double*>(mean), mean_dim, mean_shape,
+                                                   reinterpret_cast<double*>(var), var_dim, var_shape, stream);
+      break;
+    default:
+      THROW_INVALID_USAGE("Unknown datatype provided.");
+      break;
+    }
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
+torchfort_result_t torchfort_inference_mc_F(const char* name, void* input, size_t input_dim, int64_t* input_shape,
+                                            int64_t n_samples, void* mean, size_t mean_dim, int64_t* mean_shape,
+                                            void* var, size_t var_dim, int64_t* var_shape, torchfort_datatype_t dtype,
+                                            cudaStream_t stream) {
+  using namespace torchfort;
+  try {
+    switch (dtype) {
+    case TORCHFORT_FLOAT:
+      torchfort::inference_mc<torchfort::ColMajor>(name, reinterpret_cast<float*>(input), input_dim, input_shape,
+                                                   n_samples, reinterpret_cast<float*>(mean), mean_dim, mean_shape,
+                                                   reinterpret_cast<float*>(var), var_dim, var_shape, stream);
+      break;
+    case TORCHFORT_DOUBLE:
+      torchfort::inference_mc<torchfort::ColMajor>(name, reinterpret_cast<double*>(input), input_dim, input_shape,
+                                                   n_samples, reinterpret_cast<double*>(mean), mean_dim, mean_shape,
+                                                   reinterpret_cast<double*>(var), var_dim, var_shape, stream);
+      break;
+    default:
+      THROW_INVALID_USAGE("Unknown datatype provided.");
+      break;
+    }
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
+torchfort_result_t torchfort_create_pipeline(const char* name, const char* config_fname) {
+  using namespace torchfort;
+  try {
+    YAML::Node config;
+    try {
+      config = YAML::LoadFile(config_fname);
+    } catch (const std::exception& e) {
+      THROW_INVALID_USAGE("Pipeline configuration file failed to load.");
+    }
+
+    if (!config["pipeline"]) {
+      THROW_INVALID_USAGE("Missing pipeline block in configuration file.");
+    }
+    pipelines[name] = get_pipeline(config["pipeline"]);
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
+torchfort_result_t torchfort_inference_pipeline(const char* name, void* input, size_t input_dim,
+                                                int64_t* input_shape, void* output, size_t output_dim,
+                                                int64_t* output_shape, torchfort_datatype_t dtype,
+                                                cudaStream_t stream) {
+  using namespace torchfort;
+  try {
+    switch (dtype) {
+    case TORCHFORT_FLOAT:
+      torchfort::inference_pipeline<torchfort::RowMajor>(name, reinterpret_cast<float*>(input), input_dim, input_shape,
+                                                         reinterpret_cast<float*>(output), output_dim, output_shape,
+                                                         stream);
+      break;
+    case TORCHFORT_DOUBLE:
+      torchfort::inference_pipeline<torchfort::RowMajor>(name, reinterpret_cast<double*>(input), input_dim, input_shape,
+                                                         reinterpret_cast<double*>(output), output_dim, output_shape,
+                                                         stream);
+      break;
+    default:
+      THROW_INVALID_USAGE("Unknown datatype provided.");
+      break;
+    }
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
+torchfort_result_t torchfort_inference_pipeline_F(const char* name, void* input, size_t input_dim,
+                                                  int64_t* input_shape, void* output, size_t output_dim,
+                                                  int64_t* output_shape, torchfort_datatype_t dtype,
+                                                  cudaStream_t stream) {
+  using namespace torchfort;
+  try {
+    switch (dtype) {
+    case TORCHFORT_FLOAT:
+      torchfort::inference_pipeline<torchfort::ColMajor>(name, reinterpret_cast<float*>(input), input_dim, input_shape,
+                                                         reinterpret_cast<float*>(output), output_dim, output_shape,
+                                                         stream);
+      break;
+    case TORCHFORT_DOUBLE:
+      torchfort::inference_pipeline<torchfort::ColMajor>(name, reinterpret_cast<double*>(input), input_dim, input_shape,
+                                                         reinterpret_cast<double*>(output), output_dim, output_shape,
+                                                         stream);
+      break;
+    default:
+      THROW_INVALID_USAGE("Unknown datatype provided.");
+      break;
+    }
+  } catch (const BaseException& e) {
+    std::cerr << e.what();
+    return e.getResult();
+  }
+  return TORCHFORT_RESULT_SUCCESS;
+}
+
 torchfort_result_t torchfort_save_model(const char* name, const char* fname) {
   using namespace torchfort;
   try {
+    wait_async_training(name);
     models[name].model->save(fname);
   } catch (const BaseException& e) {
     std::cerr << e.what();
@@ -283,9 +753,10 @@ torchfort_result_t torchfort_save_model(const char* name, const char* fname) {
 torchfort_result_t torchfort_load_model(const char* name, const char* fname) {
   using namespace torchfort;
   try {
+    wait_async_training(name);
     models[name].model->load(fname);
     if (models[name].optimizer) {
-      models[name].optimizer->parameters() = models[name].model->parameters();
+      models[name].optimizer->parameters() = models[name].model->trainable_parameters();
     }
   } catch (const BaseException& e) {
     std::cerr << e.what();
@@ -297,6 +768,7 @@ torchfort_result_t torchfort_load_model(const char* name, const char* fname) {
 torchfort_result_t torchfort_save_checkpoint(const char* name, const char* checkpoint_dir) {
   using namespace torchfort;
   try {
+    wait_async_training(name);
     std::filesystem::path root_dir{checkpoint_dir};
 
     if (!std::filesystem::exists(root_dir)) {
@@ -318,6 +790,7 @@ torchfort_result_t torchfort_load_checkpoint(const char* name, const char* check
                                              int64_t* step_inference) {
   using namespace torchfort;
   try {
+    wait_async_training(name);
     std::filesystem::path root_dir{checkpoint_dir};
 
     load_model_pack(models[name], root_dir, true);